@@ -0,0 +1,113 @@
+/**
+ * @file   boundedqueue.h
+ * @brief  A bounded lock-free queue connecting two threads
+ */
+#ifndef __BOUNDEDQUEUE_H_LOADED__
+#define __BOUNDEDQUEUE_H_LOADED__
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cab {
+
+/**
+ * @brief A fixed capacity ring buffer for exactly one producer thread
+ *        and one consumer thread.
+ *
+ * tryPush and tryPop never block or lock. push and pop wait until
+ * there is room or an item, which gives a producer that gets ahead
+ * of its consumer backpressure instead of unbounded memory growth.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+  /// @param capacity  the maximum number of items (rounded up to a power of two)
+  explicit BoundedQueue(std::size_t capacity)
+    : d_slots(roundUp(capacity)),
+      d_mask(d_slots.size() - 1u),
+      d_head(0u),
+      d_tail(0u)
+  {
+  }
+
+  /// add @p value if there is room. Only the producer may call this.
+  bool tryPush(T &&value)
+  {
+    const std::size_t tail(d_tail.load(std::memory_order_relaxed));
+    if ((tail - d_head.load(std::memory_order_acquire)) > d_mask) {
+      return false;
+    }
+    d_slots[tail & d_mask] = std::move(value);
+    d_tail.store(tail + 1u, std::memory_order_release);
+    return true;
+  }
+
+  /// remove the oldest item if there is one. Only the consumer may call this.
+  bool tryPop(T &value)
+  {
+    const std::size_t head(d_head.load(std::memory_order_relaxed));
+    if (head == d_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = std::move(d_slots[head & d_mask]);
+    d_head.store(head + 1u, std::memory_order_release);
+    return true;
+  }
+
+  /// add @p value waiting for room if necessary
+  void push(T &&value)
+  {
+    for (unsigned attempt = 0u; !tryPush(std::move(value)); ++attempt) {
+      backoff(attempt);
+    }
+  }
+
+  /// remove the oldest item waiting for one if necessary
+  void pop(T &value)
+  {
+    for (unsigned attempt = 0u; !tryPop(value); ++attempt) {
+      backoff(attempt);
+    }
+  }
+
+  std::size_t capacity() const noexcept
+  {
+    return d_slots.size();
+  }
+private:
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  static std::size_t roundUp(std::size_t capacity)
+  {
+    std::size_t result(1u);
+    while (result < capacity) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  /// spin briefly, then yield, then sleep so an idle stage doesn't burn a core
+  static void backoff(unsigned attempt)
+  {
+    if (attempt < 64u) {
+      std::this_thread::yield();
+    }
+    else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  std::vector<T> d_slots;
+  const std::size_t d_mask;
+  /// the next item to pop (written by the consumer)
+  alignas(64) std::atomic<std::size_t> d_head;
+  /// the next slot to fill (written by the producer)
+  alignas(64) std::atomic<std::size_t> d_tail;
+};
+}
+
+#endif /*  __BOUNDEDQUEUE_H_LOADED__ */
@@ -0,0 +1,364 @@
+/**
+ * @file   cabbudget.cpp
+ * @brief  Allocation budgets and a throughput check for the parse stages
+ *
+ * A change that quietly doubles the allocations per row doesn't break
+ * any test in cabtests, so these tests count the heap allocations and
+ * bytes of each stage of parsing a fixed reference log and hold them
+ * to budgets per row and per cell. The global operator new is replaced
+ * to do the counting.
+ *
+ * The throughput check times the whole parse of the reference log
+ * against a calibration loop of simple string work, so the ratio
+ * between them depends much less on the machine than either time. The
+ * median ratio of several rounds is recorded as the test property
+ * ratioPermille (see --gtest_output=xml). Timing still depends on the
+ * load of the machine, so the check only fails when the ratio falls
+ * more than s_allowedDrop below the baseline stored in s_baselineRatio
+ * and CAB_CHECK_THROUGHPUT is set in the environment, as on a quiet
+ * machine kept for benchmarks:
+ *
+ *   CAB_CHECK_THROUGHPUT=1 ./cabbudget --gtest_filter=*Throughput
+ *
+ * When a change makes parsing faster on purpose, update the baseline
+ * from the median of that property over several runs.
+ */
+#include "gtest/gtest.h"
+#include "filemap.h"
+#include "scorer.h"
+#include "stringreg.h"
+#include "tabletext.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+std::atomic<std::size_t> s_allocations(0u);
+std::atomic<std::size_t> s_allocatedBytes(0u);
+
+void *
+countedAllocation(std::size_t size)
+{
+  s_allocations.fetch_add(1u, std::memory_order_relaxed);
+  s_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  void *const result(std::malloc(size ? size : 1u));
+  if (!result) {
+    throw std::bad_alloc();
+  }
+  return result;
+}
+}
+
+void *
+operator new(std::size_t size)
+{
+  return countedAllocation(size);
+}
+
+void *
+operator new[](std::size_t size)
+{
+  return countedAllocation(size);
+}
+
+void
+operator delete(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete[](void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void *ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete[](void *ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace {
+/// the median ratio of parse throughput to calibration throughput when the baseline was taken
+const double s_baselineRatio(0.49);
+/// the fraction the ratio may fall below the baseline before the check fails
+const double s_allowedDrop(0.15);
+/// the number of rounds of timing whose median ratio is checked
+const unsigned s_numRounds(21u);
+
+/// the heap allocations made by one call
+struct Allocations {
+  std::size_t count;
+  std::size_t bytes;
+};
+
+template <typename Func>
+Allocations
+countAllocations(Func &&func)
+{
+  const std::size_t count(s_allocations.load());
+  const std::size_t bytes(s_allocatedBytes.load());
+  func();
+  return Allocations{ s_allocations.load() - count, s_allocatedBytes.load() - bytes };
+}
+
+const std::size_t s_numQSOs(4000u);
+
+/**
+ * @brief a log with DOS line ends, a tag after spaces, a wrapped
+ *        SOAPBOX line and X-QSO lines, so every pass has work to do
+ */
+std::string
+referenceLog()
+{
+  static const char *const calls[] = {
+    "KJ4AOM", "N4JF", "K0RC", "NT2A", "DL5MU", "K4AMC", "SP6JOE", "W3TB", "LY5W",
+    "OH6NIO", "VE3KP", "JA1ABC"
+  };
+  static const char *const mults[] = {
+    "KY", "AL", "MN", "NY", "Federal Republic of Germany", "TN", "Poland", "VA",
+    "Lithuania", "Finland", "ON", "Japan"
+  };
+  std::string log("START-OF-LOG: 3.0\r\n  CALLSIGN: W1AW\r\nCONTEST: CA-QSO-PARTY\r\n"
+                  "SOAPBOX: a long day in the chair with many stations to work and\r\n"
+                  "a few more lines of text\r\nCREATED-BY: cabbudget\r\n");
+  char line[128];
+  for (std::size_t i = 0u; i < s_numQSOs; ++i) {
+    const std::size_t which((i*7u) % 12u);
+    std::snprintf(line, sizeof(line),
+                  "QSO: %5u CW 2014-10-04 %02u%02u W1AW       %03u ORAN      %-10s %3u %s\r\n",
+                  (i % 3u) ? 21000u : 14000u, static_cast<unsigned>(16u + (i/60u) % 8u),
+                  static_cast<unsigned>(i % 60u), static_cast<unsigned>(i % 1000u),
+                  calls[which], static_cast<unsigned>(1u + (i*13u) % 60u), mults[which]);
+    log.append(line);
+    if (0u == (i % 500u)) {
+      log.append("X-QSO: 21000 CW 2014-10-04 1700 W1AW       999 ORAN      N0CALL       1 MN\r\n");
+    }
+  }
+  log.append("END-OF-LOG:\r\n");
+  return log;
+}
+
+const std::string &
+reference()
+{
+  static const std::string s_log(referenceLog());
+  return s_log;
+}
+
+/// parse the reference log the way the pipeline does
+std::size_t
+parseReference()
+{
+  const std::string text(cab::normalizeLog(reference()));
+  const cab::HeaderList header(cab::headerTags(text));
+  const cab::TableText table(cab::qsoLines(text));
+  return header.size() + table.tabulate(11u).size();
+}
+
+/// string work with a similar mix of scanning, copying and small allocations
+std::size_t
+calibrate()
+{
+  const std::string &text(reference());
+  std::size_t result(0u);
+  std::size_t begin(0u);
+  for (std::size_t end = text.find('\n'); end != std::string::npos;
+       begin = end + 1u, end = text.find('\n', begin)) {
+    std::string line(text, begin, end - begin);
+    std::size_t pos(0u);
+    while ((pos = line.find_first_not_of(' ', pos)) != std::string::npos) {
+      const std::size_t wordEnd(std::min(line.find(' ', pos), line.size()));
+      const std::string word(line, pos, wordEnd - pos);
+      result += cab::hash64(word.data(), word.size()) & 1u;
+      pos = wordEnd;
+    }
+  }
+  return result;
+}
+
+/// the time of one run of @p func in seconds
+template <typename Func>
+double
+timeOnce(Func &&func)
+{
+  const auto start(std::chrono::steady_clock::now());
+  volatile std::size_t sink(func());
+  (void)sink;
+  const std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - start);
+  return elapsed.count();
+}
+
+/// the median of @p values
+double
+median(std::vector<double> values)
+{
+  std::sort(values.begin(), values.end());
+  const std::size_t mid(values.size()/2u);
+  return (values.size() % 2u) ? values[mid] : 0.5*(values[mid - 1u] + values[mid]);
+}
+}
+
+TEST(CabrilloBudget, NormalizationPasses)
+{
+  // each pass makes one copy of the text, with room for a few
+  // reallocations if it grows
+  const std::string &log(reference());
+  const std::size_t passBytes(log.size() + log.size()/4u);
+  std::string text;
+  const Allocations eol(countAllocations([&]() {
+    text = cab::translateeol(log);
+  }));
+  EXPECT_GE(2u, eol.count);
+  EXPECT_GE(passBytes, eol.bytes);
+  const Allocations spaces(countAllocations([&]() {
+    text = cab::removeSpaceBeforeTags(text);
+  }));
+  EXPECT_GE(2u, spaces.count);
+  EXPECT_GE(passBytes, spaces.bytes);
+  const Allocations wrapped(countAllocations([&]() {
+    text = cab::fixWrappedLines(text);
+  }));
+  EXPECT_GE(2u, wrapped.count);
+  EXPECT_GE(passBytes, wrapped.bytes);
+  const Allocations xqso(countAllocations([&]() {
+    text = cab::removeXQSOLines(text);
+  }));
+  EXPECT_GE(2u, xqso.count);
+  EXPECT_GE(passBytes, xqso.bytes);
+  std::string qsos;
+  const Allocations lines(countAllocations([&]() {
+    qsos = cab::qsoLines(text);
+  }));
+  EXPECT_GE(2u, lines.count);
+  EXPECT_GE(passBytes, lines.bytes);
+
+  // the header takes its strings and the growth of the list
+  cab::HeaderList header;
+  const Allocations tags(countAllocations([&]() {
+    header = cab::headerTags(text);
+  }));
+  std::size_t tagBytes(0u);
+  for (const cab::HeaderTag &tag : header) {
+    tagBytes += tag.tag.size() + tag.value.size() + 2u;
+  }
+  EXPECT_EQ(6u, header.size());
+  EXPECT_GE(2u*header.size() + 4u, tags.count);
+  EXPECT_GE(2u*tagBytes + 4u*header.size()*sizeof(cab::HeaderTag), tags.bytes);
+}
+
+TEST(CabrilloBudget, Tabulation)
+{
+  const std::string qsos(cab::qsoLines(cab::normalizeLog(reference())));
+  std::unique_ptr<cab::TableText> table;
+  const Allocations construct(countAllocations([&]() {
+    table.reset(new cab::TableText(qsos));
+  }));
+  // the copy of the text and the space counts, but nothing per row
+  // beyond the growth of the line index
+  EXPECT_GE(32u, construct.count);
+  EXPECT_GE(2u*qsos.size(), construct.bytes);
+
+  cab::TableText::RowAndColumnList rows;
+  const Allocations tabulate(countAllocations([&]() {
+    table->tabulate(11u, rows);
+  }));
+  ASSERT_EQ(s_numQSOs, rows.size());
+  // one allocation for each row, and one for each cell too long for
+  // the small string buffer
+  const std::size_t smallString(std::string().capacity());
+  std::size_t cells(0u), longCells(0u), longBytes(0u);
+  for (const auto &row : rows) {
+    cells += row.size();
+    for (const auto &cell : row) {
+      if (cell.size() > smallString) {
+        ++longCells;
+        longBytes += cell.size() + 1u;
+      }
+    }
+  }
+  EXPECT_GE(rows.size() + longCells + 32u, tabulate.count);
+  EXPECT_GE(cells*sizeof(std::string) + 2u*rows.size()*sizeof(rows[0]) + 2u*longBytes,
+            tabulate.bytes);
+
+  // tabulating again into the same rows reuses their memory
+  const Allocations again(countAllocations([&]() {
+    table->tabulate(11u, rows);
+  }));
+  EXPECT_GE(16u, again.count);
+  EXPECT_GE(4096u, again.bytes);
+}
+
+TEST(CabrilloBudget, Scoring)
+{
+  // every station is worked on two bands and two modes, so no row is
+  // a duplicate
+  const std::size_t numCalls(s_numQSOs/4u);
+  cab::TableText::RowAndColumnList rows;
+  rows.reserve(s_numQSOs);
+  char call[16];
+  for (std::size_t i = 0u; i < numCalls; ++i) {
+    std::snprintf(call, sizeof(call), "w%u%c%c%c", static_cast<unsigned>(i % 10u),
+                  static_cast<char>('a' + (i/10u) % 26u), static_cast<char>('a' + (i/260u) % 26u),
+                  static_cast<char>('a' + i % 7u));
+    for (const char *const freq : { "14000", "21000" }) {
+      for (const char *const mode : { "CW", "ph" }) {
+        rows.push_back(std::vector<std::string> { "QSO:", freq, mode, "2014-10-04", "1700",
+                                                  "W1AW", "001", "ORAN", call, "1", "ky" });
+      }
+    }
+  }
+  cab::ScoringRules rules;
+  rules.points.push_back(cab::ScoringRules::ModePoints{ "CW", 3u });
+  rules.multipliers = { "KY", "AL", "MN", "NY", "TN", "VA", "ON" };
+  const cab::Scorer scorer(rules);
+  cab::Score score;
+  const Allocations scoring(countAllocations([&]() {
+    score = scorer.score(rows);
+  }));
+  EXPECT_EQ(rows.size(), score.qsos);
+  // the tables of the log and one entry for each distinct callsign
+  // and mode, but nothing for each row
+  EXPECT_GE(numCalls + 64u, scoring.count);
+  EXPECT_GE(96u*numCalls + 16u*rows.size() + 4096u, scoring.bytes);
+}
+
+TEST(CabrilloBudget, Throughput)
+{
+  // warm up, then time the two back to back in each round, so a round
+  // sees the machine in one state
+  parseReference();
+  calibrate();
+  std::vector<double> parse, calibration, ratios;
+  for (unsigned round = 0u; round < s_numRounds; ++round) {
+    parse.push_back(timeOnce(parseReference));
+    calibration.push_back(timeOnce(calibrate));
+    ratios.push_back(calibration.back()/parse.back());
+  }
+  const double ratio(median(ratios));
+  RecordProperty("parseMBps", static_cast<int>(reference().size()/median(parse)/1e6));
+  RecordProperty("calibrationMBps", static_cast<int>(reference().size()/median(calibration)/1e6));
+  RecordProperty("ratioPermille", static_cast<int>(1000.0*ratio));
+  RecordProperty("baselinePermille", static_cast<int>(1000.0*s_baselineRatio));
+#if defined(__OPTIMIZE__) && !defined(__SANITIZE_ADDRESS__)
+  if (std::getenv("CAB_CHECK_THROUGHPUT")) {
+    EXPECT_LE((1.0 - s_allowedDrop)*s_baselineRatio, ratio)
+        << "parsing is more than " << 100.0*s_allowedDrop
+        << "% slower than the baseline relative to the calibration loop";
+  }
+#endif
+}
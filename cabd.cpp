@@ -0,0 +1,128 @@
+/**
+ * @file   cabd.cpp
+ * @brief  Daemon that tabulates Cabrillo logs sent over a socket
+ *
+ * Usage: cabd [--socket PATH | --port N] [--threads N] [--max-clients N]
+ *             [--idle-timeout MS]
+ *
+ * The server runs until it receives SIGINT or SIGTERM, then reports
+ * its request latency on stderr. See cabserver.h for the protocol.
+ */
+#include "cabserver.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <pthread.h>
+
+namespace {
+void
+usage(std::ostream &out)
+{
+  out << "Usage: cabd [--socket PATH | --port N] [--threads N] [--max-clients N]\n"
+      "            [--idle-timeout MS]\n"
+      "Serve Cabrillo log tabulation requests until interrupted.\n\n"
+      "  --socket PATH  listen on a Unix domain socket (default /tmp/cabd.sock)\n"
+      "  --port N       listen on TCP port N of 127.0.0.1 instead\n"
+      "  --threads N    requests handled at once (default 4)\n"
+      "  --max-clients N\n"
+      "                 clients connected at once (default 1024)\n"
+      "  --idle-timeout MS\n"
+      "                 disconnect clients idle this long, 0 for never (default 30000)\n"
+      "  --help         show this message\n";
+}
+
+unsigned
+parseCount(const char *option, const char *value)
+{
+  char *end(nullptr);
+  const unsigned long result(value ? std::strtoul(value, &end, 10) : 0ul);
+  if (!value || !*value || *end) {
+    throw std::invalid_argument(std::string(option) + " needs a number");
+  }
+  return static_cast<unsigned>(result);
+}
+}
+
+int
+main(int argc, char **argv)
+{
+  cab::ParseServer::Options options;
+  options.socketPath = "/tmp/cabd.sock";
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const char *const arg(argv[i]);
+      const char *const value((i + 1 < argc) ? argv[i + 1] : nullptr);
+      if (!std::strcmp(arg, "--socket") && value) {
+        options.socketPath = value;
+        ++i;
+      }
+      else if (!std::strcmp(arg, "--port")) {
+        const unsigned port(parseCount(arg, value));
+        if (port > 65535u) {
+          throw std::invalid_argument("--port must be less than 65536");
+        }
+        options.tcpPort = static_cast<unsigned short>(port);
+        options.socketPath.clear();
+        ++i;
+      }
+      else if (!std::strcmp(arg, "--threads")) {
+        options.threads = parseCount(arg, value);
+        ++i;
+      }
+      else if (!std::strcmp(arg, "--max-clients")) {
+        options.maxConnections = parseCount(arg, value);
+        ++i;
+      }
+      else if (!std::strcmp(arg, "--idle-timeout")) {
+        options.idleTimeout = parseCount(arg, value);
+        ++i;
+      }
+      else if (!std::strcmp(arg, "--help")) {
+        usage(std::cout);
+        return EXIT_SUCCESS;
+      }
+      else {
+        throw std::invalid_argument(std::string("Unknown option: ") + arg);
+      }
+    }
+  }
+  catch (const std::exception &e) {
+    std::cerr << "cabd: " << e.what() << '\n';
+    usage(std::cerr);
+    return EXIT_FAILURE;
+  }
+
+  // block the signals in every thread so sigwait() below receives them
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);
+  try {
+    cab::ParseServer server(options);
+    if (options.socketPath.empty()) {
+      std::cerr << "cabd: listening on 127.0.0.1:" << server.getPort() << '\n';
+    }
+    else {
+      std::cerr << "cabd: listening on " << options.socketPath << '\n';
+    }
+    int received(0);
+    sigwait(&signals, &received);
+    server.stop();
+    const cab::LatencyStats stats(server.getStats());
+    std::cerr << "cabd: " << stats.requests << " requests, latency p50 "
+              << stats.p50Microseconds << "us p90 " << stats.p90Microseconds
+              << "us p99 " << stats.p99Microseconds << "us max "
+              << stats.maxMicroseconds << "us\n";
+  }
+  catch (const std::exception &e) {
+    std::cerr << "cabd: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+/**
+ * @file   cabparse.cpp
+ * @brief  Command line tool to normalize and tabulate Cabrillo logs
+ *
+ * Usage: cabparse [options] [file|directory|-]...
+ *
+ * Each log is normalized, its QSO lines are tabulated, and the rows
+ * are written to standard output as TSV or JSON lines with the file
+ * name as the first field, or saved as binary table cache files.
+ */
+#include "pipeline.h"
+#include "tablecache.h"
+#include "tableexport.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+enum class OutputFormat {
+  TSV,
+  JSONLines,
+  Binary
+};
+
+struct Settings {
+  unsigned jobs = 1u;
+  unsigned minCols = 0u;
+  OutputFormat format = OutputFormat::TSV;
+  std::string outputDir;
+  bool stats = false;
+  cab::TableText::Options table;
+  std::vector<std::string> inputs;
+};
+
+void
+usage(std::ostream &out)
+{
+  out << "Usage: cabparse [options] [file|directory|-]...\n"
+      "Normalize Cabrillo logs and write their tabulated QSO lines.\n"
+      "With no inputs, or an input of -, standard input is read.\n"
+      "Files ending in .gz or .zip are decompressed as they are read.\n\n"
+      "  --jobs N          process N logs at a time (default 1)\n"
+      "  --min-cols N      require at least N columns (default 0)\n"
+      "  --format FORMAT   tsv (default), jsonl, or binary\n"
+      "  --output-dir DIR  where binary caches are written (default: next\n"
+      "                    to each input as NAME.cabtbl)\n"
+      "  --max-bytes N     reject logs larger than N bytes\n"
+      "  --max-rows N      reject logs with more than N QSO lines\n"
+      "  --max-width N     reject logs with QSO lines wider than N columns\n"
+      "  --clip-wide-lines clip lines wider than --max-width instead\n"
+      "  --stats           report per phase timing and throughput on stderr\n"
+      "  --help            show this message\n";
+}
+
+/// parse @p value as a count no larger than @p limit
+std::size_t
+parseSize(const char *option, const char *value,
+          std::size_t limit = std::numeric_limits<std::size_t>::max())
+{
+  // strtoull accepts a sign, which would wrap a negative count around
+  if (!value || (*value < '0') || (*value > '9')) {
+    throw std::invalid_argument(std::string(option) + " needs a number");
+  }
+  char *end(nullptr);
+  errno = 0;
+  const unsigned long long result(std::strtoull(value, &end, 10));
+  if (*end) {
+    throw std::invalid_argument(std::string(option) + " needs a number");
+  }
+  if ((ERANGE == errno) || (result > limit)) {
+    throw std::invalid_argument(std::string(option) + " is too large: " + value);
+  }
+  return static_cast<std::size_t>(result);
+}
+
+unsigned
+parseCount(const char *option, const char *value)
+{
+  return static_cast<unsigned>(parseSize(option, value,
+                                         std::numeric_limits<unsigned>::max()));
+}
+
+/// add the regular files under @p path to @p files
+void
+addInput(const std::string &path, std::vector<std::string> &files)
+{
+  if ("-" == path) {
+    files.push_back("/dev/stdin");
+    return;
+  }
+  struct stat info;
+  if ((0 == ::stat(path.c_str(), &info)) && S_ISDIR(info.st_mode)) {
+    DIR *dir(::opendir(path.c_str()));
+    if (!dir) {
+      throw std::runtime_error("Unable to read directory " + path);
+    }
+    std::vector<std::string> entries;
+    while (const struct dirent *entry = ::readdir(dir)) {
+      if (('.' != entry->d_name[0])) {
+        entries.push_back(path + "/" + entry->d_name);
+      }
+    }
+    ::closedir(dir);
+    std::sort(entries.begin(), entries.end());
+    for (const std::string &entry : entries) {
+      addInput(entry, files);
+    }
+  }
+  else {
+    // missing files are reported by the pipeline
+    files.push_back(path);
+  }
+}
+
+Settings
+parseArguments(int argc, char **argv)
+{
+  Settings settings;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if ("--jobs" == arg) {
+      settings.jobs = std::max(1u, parseCount(argv[i], argv[i+1]));
+      ++i;
+    }
+    else if ("--min-cols" == arg) {
+      settings.minCols = parseCount(argv[i], argv[i+1]);
+      ++i;
+    }
+    else if ("--max-bytes" == arg) {
+      settings.table.maxBytes = parseSize(argv[i], argv[i+1]);
+      ++i;
+    }
+    else if ("--max-rows" == arg) {
+      settings.table.maxRows = parseSize(argv[i], argv[i+1]);
+      ++i;
+    }
+    else if ("--max-width" == arg) {
+      settings.table.maxWidth = parseSize(argv[i], argv[i+1]);
+      ++i;
+    }
+    else if ("--clip-wide-lines" == arg) {
+      settings.table.clipWideLines = true;
+    }
+    else if ("--format" == arg) {
+      const std::string format(argv[i+1] ? argv[i+1] : "");
+      if ("tsv" == format) {
+        settings.format = OutputFormat::TSV;
+      }
+      else if ("jsonl" == format) {
+        settings.format = OutputFormat::JSONLines;
+      }
+      else if ("binary" == format) {
+        settings.format = OutputFormat::Binary;
+      }
+      else {
+        throw std::invalid_argument("Unknown format: " + format);
+      }
+      ++i;
+    }
+    else if ("--output-dir" == arg) {
+      if (!argv[i+1]) {
+        throw std::invalid_argument("--output-dir needs a directory");
+      }
+      settings.outputDir = argv[++i];
+    }
+    else if ("--stats" == arg) {
+      settings.stats = true;
+    }
+    else if ("--help" == arg) {
+      usage(std::cout);
+      std::exit(EXIT_SUCCESS);
+    }
+    else if ((arg.size() > 1u) && ('-' == arg[0])) {
+      throw std::invalid_argument("Unknown option: " + arg);
+    }
+    else {
+      inputs.push_back(arg);
+    }
+  }
+  if (inputs.empty()) {
+    inputs.push_back("-");
+  }
+  for (const std::string &input : inputs) {
+    addInput(input, settings.inputs);
+  }
+  return settings;
+}
+
+std::string
+cachePath(const Settings &settings, const std::string &input)
+{
+  const std::string name(("/dev/stdin" == input) ? std::string("stdin") : input);
+  if (settings.outputDir.empty()) {
+    return name + ".cabtbl";
+  }
+  const std::size_t slash(name.rfind('/'));
+  return settings.outputDir + "/" +
+         ((std::string::npos == slash) ? name : name.substr(slash + 1u)) + ".cabtbl";
+}
+}
+
+int
+main(int argc, char **argv)
+{
+  Settings settings;
+  try {
+    settings = parseArguments(argc, argv);
+  }
+  catch (const std::exception &e) {
+    std::cerr << "cabparse: " << e.what() << "\n";
+    usage(std::cerr);
+    return EXIT_FAILURE;
+  }
+
+  cab::OutputBuffer out(STDOUT_FILENO);
+  cab::TableExporter exporter(out, (OutputFormat::JSONLines == settings.format) ?
+                              cab::TableExporter::Format::JSONLines :
+                              cab::TableExporter::Format::TSV);
+  std::mutex outputMutex;
+  std::size_t failures(0u), numRows(0u), numBytes(0u);
+  cab::TableText::SpanRow spans;
+
+  // called on the consumer thread of each pipeline
+  auto consume = [&](cab::LogJob &job) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    if (!job.error.empty()) {
+      std::cerr << "cabparse: " << job.name << ": " << job.error << "\n";
+      ++failures;
+      return;
+    }
+    numRows += job.rows.size();
+    numBytes += job.source.size();
+    if (OutputFormat::Binary == settings.format) {
+      try {
+        cab::writeTableCache(cachePath(settings, job.name), job.source, job.header,
+                             job.layout, job.rows);
+      }
+      catch (const std::exception &e) {
+        std::cerr << "cabparse: " << job.name << ": " << e.what() << "\n";
+        ++failures;
+      }
+      return;
+    }
+    for (const auto &row : job.rows) {
+      spans.clear();
+      spans.push_back(cab::TableText::FieldSpan{ job.name.data(), job.name.size() });
+      for (const std::string &field : row) {
+        spans.push_back(cab::TableText::FieldSpan{ field.data(), field.size() });
+      }
+      exporter.writeRow(spans);
+    }
+  };
+
+  // each job runs its own pipeline over every Nth input
+  const unsigned numJobs(std::min<std::size_t>(settings.jobs,
+                                               std::max<std::size_t>(1u, settings.inputs.size())));
+  std::vector<std::vector<std::string>> partitions(numJobs);
+  for (std::size_t i = 0u; i < settings.inputs.size(); ++i) {
+    partitions[i % numJobs].push_back(settings.inputs[i]);
+  }
+  cab::Pipeline::Options options;
+  options.minCols = settings.minCols;
+  options.table = settings.table;
+  std::vector<cab::Pipeline> pipelines;
+  pipelines.reserve(numJobs);
+  for (unsigned job = 0u; job < numJobs; ++job) {
+    pipelines.emplace_back(consume, options);
+  }
+  // an exception must not escape a thread, nor unwind past one that
+  // is still running, so each job keeps its own and every thread is
+  // joined before the first is reported
+  std::vector<std::exception_ptr> errors(numJobs);
+  const auto runJob([&pipelines, &partitions, &errors](unsigned job) {
+    try {
+      pipelines[job].run(partitions[job]);
+    }
+    catch (...) {
+      errors[job] = std::current_exception();
+    }
+  });
+  const auto start(std::chrono::steady_clock::now());
+  std::vector<std::thread> threads;
+  for (unsigned job = 1u; job < numJobs; ++job) {
+    try {
+      threads.emplace_back(runJob, job);
+    }
+    catch (...) {
+      errors[job] = std::current_exception();
+    }
+  }
+  runJob(0u);
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  try {
+    for (const std::exception_ptr &error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+    out.flush();
+  }
+  catch (const std::exception &e) {
+    std::cerr << "cabparse: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  const double seconds(std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                       start).count());
+
+  if (settings.stats) {
+    std::cerr << "logs: " << settings.inputs.size() << " failed: " << failures
+              << " rows: " << numRows << " bytes: " << numBytes << "\n"
+              << "elapsed: " << seconds << " s, "
+              << (seconds > 0.0 ? (numBytes / seconds / 1.0e6) : 0.0) << " MB/s, "
+              << (seconds > 0.0 ? (numRows / seconds) : 0.0) << " rows/s\n";
+    for (unsigned stage = 0u; stage < cab::Pipeline::e_NumStages; ++stage) {
+      cab::StageStats total{ pipelines[0].getStats()[stage].name, 0u, 0u, 0u };
+      for (const cab::Pipeline &pipeline : pipelines) {
+        total.items += pipeline.getStats()[stage].items;
+        total.busyNanoseconds += pipeline.getStats()[stage].busyNanoseconds;
+        total.waitNanoseconds += pipeline.getStats()[stage].waitNanoseconds;
+      }
+      std::cerr << total.name << ": " << total.items << " logs, "
+                << (total.busyNanoseconds / 1.0e6) << " ms busy, "
+                << (total.waitNanoseconds / 1.0e6) << " ms waiting, "
+                << static_cast<int>(100.0 * total.utilization()) << "% utilization\n";
+    }
+  }
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
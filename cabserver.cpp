@@ -0,0 +1,735 @@
+#include "cabserver.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace cab;
+
+namespace {
+#if defined(MSG_NOSIGNAL)
+const int s_sendFlags(MSG_NOSIGNAL);
+#else
+const int s_sendFlags(0);
+#endif
+
+/// the number of latencies kept for the percentiles
+const std::size_t s_latencyWindow(1u << 16);
+
+/// the most payload read from a client at once
+const std::size_t s_readChunk(1u << 16);
+
+[[noreturn]] void
+throwErrno(const std::string &what)
+{
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+/// thrown when the other end closes the connection between frames
+struct Disconnected {
+};
+
+void
+appendVarint(std::string &buf, std::uint64_t value)
+{
+  while (value >= 0x80u) {
+    buf.push_back(static_cast<char>((value & 0x7fu) | 0x80u));
+    value >>= 7;
+  }
+  buf.push_back(static_cast<char>(value));
+}
+
+void
+appendString(std::string &buf, const char *data, std::size_t len)
+{
+  appendVarint(buf, len);
+  buf.append(data, len);
+}
+
+/// read a varint from @p buf starting at @p pos
+std::uint64_t
+readVarint(const std::string &buf, std::size_t &pos)
+{
+  std::uint64_t result(0u);
+  for (unsigned shift = 0u; shift < 64u; shift += 7u) {
+    if (pos >= buf.size()) {
+      throw std::runtime_error("Truncated message");
+    }
+    const unsigned char byte(static_cast<unsigned char>(buf[pos++]));
+    result |= static_cast<std::uint64_t>(byte & 0x7fu) << shift;
+    if (!(byte & 0x80u)) {
+      return result;
+    }
+  }
+  throw std::runtime_error("Bad varint in message");
+}
+
+std::string
+readString(const std::string &buf, std::size_t &pos)
+{
+  const std::uint64_t len(readVarint(buf, pos));
+  if (len > (buf.size() - pos)) {
+    throw std::runtime_error("Truncated message");
+  }
+  const std::string result(buf, pos, static_cast<std::size_t>(len));
+  pos += static_cast<std::size_t>(len);
+  return result;
+}
+
+/// read exactly @p len bytes. Returns false if the connection closed first.
+bool
+readFully(int fd, char *data, std::size_t len)
+{
+  while (len > 0u) {
+    const ssize_t got(::recv(fd, data, len, 0));
+    if (got < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      throwErrno("Unable to read from socket");
+    }
+    if (0 == got) {
+      return false;
+    }
+    data += got;
+    len -= static_cast<std::size_t>(got);
+  }
+  return true;
+}
+
+void
+writeFully(int fd, const char *data, std::size_t len)
+{
+  while (len > 0u) {
+    const ssize_t sent(::send(fd, data, len, s_sendFlags));
+    if (sent < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      throwErrno("Unable to write to socket");
+    }
+    data += sent;
+    len -= static_cast<std::size_t>(sent);
+  }
+}
+
+/// start a frame in @p buf leaving room for the length
+void
+beginFrame(std::string &buf, unsigned char type)
+{
+  buf.assign(4u, '\0');
+  buf.push_back(static_cast<char>(type));
+}
+
+/// fill in the length and send the frame
+void
+sendFrame(int fd, std::string &buf)
+{
+  const std::size_t len(buf.size() - 4u);
+  for (unsigned i = 0u; i < 4u; ++i) {
+    buf[i] = static_cast<char>((len >> (8u*i)) & 0xffu);
+  }
+  writeFully(fd, buf.data(), buf.size());
+}
+
+/**
+ * @brief read a frame into @p payload and return its type
+ * @exception Disconnected  the connection closed before the frame started
+ */
+unsigned char
+receiveFrame(int fd, std::string &payload, std::size_t maxBytes)
+{
+  unsigned char header[5];
+  if (!readFully(fd, reinterpret_cast<char *>(header), 1u)) {
+    throw Disconnected();
+  }
+  if (!readFully(fd, reinterpret_cast<char *>(header + 1), 4u)) {
+    throw std::runtime_error("Truncated frame");
+  }
+  const std::size_t len(static_cast<std::size_t>(header[0]) |
+                        (static_cast<std::size_t>(header[1]) << 8) |
+                        (static_cast<std::size_t>(header[2]) << 16) |
+                        (static_cast<std::size_t>(header[3]) << 24));
+  if ((len < 1u) || (len > maxBytes)) {
+    throw std::runtime_error("Bad frame length");
+  }
+  payload.resize(len - 1u);
+  if (!readFully(fd, &payload[0], len - 1u)) {
+    throw std::runtime_error("Truncated frame");
+  }
+  return header[4];
+}
+
+/**
+ * @brief remove the socket file a server left at @p path when it
+ *        stopped without cleaning up
+ * @exception std::system_error  @p path is not a socket, or a server is
+ *                               still listening on it
+ */
+void
+removeStaleSocket(const std::string &path, const struct sockaddr_un &addr)
+{
+  struct stat info;
+  if (::lstat(path.c_str(), &info) < 0) {
+    if (ENOENT == errno) {
+      return;
+    }
+    throwErrno("Unable to examine " + path);
+  }
+  if (!S_ISSOCK(info.st_mode)) {
+    throw std::system_error(EEXIST, std::generic_category(),
+                            path + " exists and is not a socket");
+  }
+  const int probe(::socket(AF_UNIX, SOCK_STREAM, 0));
+  if (probe < 0) {
+    throwErrno("Unable to create socket");
+  }
+  const int result(::connect(probe, reinterpret_cast<const struct sockaddr *>(&addr),
+                             sizeof(addr)));
+  const int err(errno);
+  ::close(probe);
+  if (0 == result) {
+    throw std::system_error(EADDRINUSE, std::generic_category(),
+                            "A server is already listening on " + path);
+  }
+  if (ECONNREFUSED != err) {
+    throw std::system_error(err, std::generic_category(), "Unable to probe " + path);
+  }
+  ::unlink(path.c_str());
+}
+}
+
+ParseServer::ParseServer(const Options &options)
+  : d_options(options),
+    d_listenFd(-1),
+    d_wakeFds{ -1, -1 },
+    d_port(0u),
+    d_stopping(false),
+    d_nextLatency(0u),
+    d_numRequests(0u)
+{
+  if (!d_options.socketPath.empty()) {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (d_options.socketPath.size() >= sizeof(addr.sun_path)) {
+      throw std::invalid_argument("Socket path is too long: " + d_options.socketPath);
+    }
+    std::strcpy(addr.sun_path, d_options.socketPath.c_str());
+    removeStaleSocket(d_options.socketPath, addr);
+    d_listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (d_listenFd < 0) {
+      throwErrno("Unable to create socket");
+    }
+    if (::bind(d_listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+      const int err(errno);
+      ::close(d_listenFd);
+      throw std::system_error(err, std::generic_category(), "Unable to bind " + d_options.socketPath);
+    }
+  }
+  else {
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(d_options.tcpPort);
+    d_listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (d_listenFd < 0) {
+      throwErrno("Unable to create socket");
+    }
+    const int reuse(1);
+    ::setsockopt(d_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    socklen_t addrLen(sizeof(addr));
+    if ((::bind(d_listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) ||
+        (::getsockname(d_listenFd, reinterpret_cast<struct sockaddr *>(&addr), &addrLen) < 0)) {
+      const int err(errno);
+      ::close(d_listenFd);
+      throw std::system_error(err, std::generic_category(), "Unable to bind port");
+    }
+    d_port = ntohs(addr.sin_port);
+  }
+  // a client that gives up before it is accepted can't block the I/O thread
+  if ((::listen(d_listenFd, 64) < 0) ||
+      (::fcntl(d_listenFd, F_SETFL, ::fcntl(d_listenFd, F_GETFL) | O_NONBLOCK) < 0)) {
+    const int err(errno);
+    ::close(d_listenFd);
+    throw std::system_error(err, std::generic_category(), "Unable to listen");
+  }
+  if (::pipe(d_wakeFds) < 0) {
+    const int err(errno);
+    ::close(d_listenFd);
+    throw std::system_error(err, std::generic_category(), "Unable to create pipe");
+  }
+  for (const int fd : d_wakeFds) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+  }
+  d_latencies.reserve(s_latencyWindow);
+  const unsigned numWorkers(std::max(1u, d_options.threads));
+  for (unsigned i = 0u; i < numWorkers; ++i) {
+    d_workers.emplace_back(&ParseServer::workerLoop, this);
+  }
+  d_ioThread = std::thread(&ParseServer::ioLoop, this);
+}
+
+ParseServer::~ParseServer()
+{
+  stop();
+}
+
+void
+ParseServer::stop()
+{
+  if (d_stopping.exchange(true)) {
+    return;
+  }
+  wake();
+  if (d_ioThread.joinable()) {
+    d_ioThread.join();
+  }
+  // end any response a worker is still sending
+  for (const auto &conn : d_connections) {
+    ::shutdown(conn.first, SHUT_RDWR);
+  }
+  d_queueReady.notify_all();
+  for (std::thread &worker : d_workers) {
+    worker.join();
+  }
+  for (const auto &conn : d_connections) {
+    ::close(conn.first);
+  }
+  d_connections.clear();
+  d_jobs.clear();
+  ::close(d_listenFd);
+  ::close(d_wakeFds[0]);
+  ::close(d_wakeFds[1]);
+  if (!d_options.socketPath.empty()) {
+    ::unlink(d_options.socketPath.c_str());
+  }
+}
+
+void
+ParseServer::wake()
+{
+  const char byte(0);
+  // a full pipe already wakes the I/O thread
+  while ((::write(d_wakeFds[1], &byte, 1u) < 0) && (EINTR == errno)) {
+  }
+}
+
+void
+ParseServer::ioLoop()
+{
+  const std::chrono::milliseconds idleTimeout(d_options.idleTimeout);
+  std::vector<std::pair<int, bool>> finished;
+  std::vector<struct pollfd> fds;
+  while (!d_stopping) {
+    {
+      std::lock_guard<std::mutex> lock(d_queueMutex);
+      finished.swap(d_finished);
+    }
+    const auto now(std::chrono::steady_clock::now());
+    for (const auto &done : finished) {
+      const auto conn(d_connections.find(done.first));
+      if (done.second) {
+        conn->second.busy = false;
+        conn->second.lastActive = now;
+      }
+      else {
+        ::close(conn->first);
+        d_connections.erase(conn);
+      }
+    }
+    finished.clear();
+    if (d_options.idleTimeout) {
+      for (auto conn = d_connections.begin(); conn != d_connections.end(); ) {
+        if (!conn->second.busy && ((now - conn->second.lastActive) > idleTimeout)) {
+          ::close(conn->first);
+          conn = d_connections.erase(conn);
+        }
+        else {
+          ++conn;
+        }
+      }
+    }
+
+    fds.clear();
+    fds.push_back(pollfd{ d_listenFd, POLLIN, 0 });
+    fds.push_back(pollfd{ d_wakeFds[0], POLLIN, 0 });
+    for (const auto &conn : d_connections) {
+      if (!conn.second.busy) {
+        fds.push_back(pollfd{ conn.first, POLLIN, 0 });
+      }
+    }
+    // wake up regularly to notice idle clients
+    if (::poll(fds.data(), fds.size(), 100) <= 0) {
+      continue;
+    }
+    if (fds[1].revents) {
+      char drain[64];
+      while (::read(d_wakeFds[0], drain, sizeof(drain)) > 0) {
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      acceptClient();
+    }
+    for (std::size_t i = 2u; i < fds.size(); ++i) {
+      if (fds[i].revents) {
+        const auto conn(d_connections.find(fds[i].fd));
+        if (!readClient(conn->first, conn->second)) {
+          ::close(conn->first);
+          d_connections.erase(conn);
+        }
+      }
+    }
+  }
+}
+
+void
+ParseServer::acceptClient()
+{
+  for (;;) {
+    const int fd(::accept(d_listenFd, nullptr, nullptr));
+    if (fd < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      // EAGAIN once the backlog is empty
+      return;
+    }
+    if (d_connections.size() >= d_options.maxConnections) {
+      ::close(fd);
+      continue;
+    }
+    addClient(fd);
+  }
+}
+
+void
+ParseServer::addClient(int fd)
+{
+  // some systems pass on O_NONBLOCK, and the workers send with blocking writes
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+#if defined(SO_NOSIGPIPE)
+  const int noSigPipe(1);
+  ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+  if (d_options.idleTimeout) {
+    // a client that stops reading its response can't hold a worker
+    struct timeval timeout;
+    timeout.tv_sec = d_options.idleTimeout / 1000u;
+    timeout.tv_usec = (d_options.idleTimeout % 1000u) * 1000u;
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  }
+  d_connections[fd].lastActive = std::chrono::steady_clock::now();
+}
+
+bool
+ParseServer::readClient(int fd, Connection &conn)
+{
+  for (;;) {
+    char *dest;
+    std::size_t wanted;
+    if (conn.received < sizeof(conn.header)) {
+      dest = reinterpret_cast<char *>(conn.header) + conn.received;
+      wanted = sizeof(conn.header) - conn.received;
+    }
+    else {
+      // the payload grows as it arrives, so a header claiming a large
+      // frame costs nothing until the bytes are sent
+      const std::size_t have(conn.received - sizeof(conn.header));
+      wanted = std::min(conn.expected - have, s_readChunk);
+      conn.payload.resize(have + wanted);
+      dest = &conn.payload[have];
+    }
+    const ssize_t got(::recv(fd, dest, wanted, MSG_DONTWAIT));
+    if (conn.received >= sizeof(conn.header)) {
+      conn.payload.resize(conn.received - sizeof(conn.header) +
+                          static_cast<std::size_t>(std::max<ssize_t>(got, 0)));
+    }
+    if (got < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return (EAGAIN == errno) || (EWOULDBLOCK == errno);
+    }
+    if (0 == got) {
+      return false;
+    }
+    conn.received += static_cast<std::size_t>(got);
+    if (conn.received == sizeof(conn.header)) {
+      const std::size_t len(static_cast<std::size_t>(conn.header[0]) |
+                            (static_cast<std::size_t>(conn.header[1]) << 8) |
+                            (static_cast<std::size_t>(conn.header[2]) << 16) |
+                            (static_cast<std::size_t>(conn.header[3]) << 24));
+      if ((len < 1u) || (len > d_options.maxRequestBytes)) {
+        // a malformed frame ends the session
+        return false;
+      }
+      conn.expected = len - 1u;
+    }
+    if ((conn.received >= sizeof(conn.header)) &&
+        (conn.received == (sizeof(conn.header) + conn.expected))) {
+      {
+        std::lock_guard<std::mutex> lock(d_queueMutex);
+        d_jobs.push_back(Job{ fd, conn.header[4], std::move(conn.payload) });
+      }
+      d_queueReady.notify_one();
+      conn.payload = std::string();
+      conn.received = 0u;
+      // the rest of what the client sent waits until the response is sent
+      conn.busy = true;
+      return true;
+    }
+  }
+}
+
+void
+ParseServer::workerLoop()
+{
+  // these keep their memory from one request to the next
+  TableText table(std::string{}, d_options.table);
+  TableText::RowAndColumnList rows;
+  std::string request, response;
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(d_queueMutex);
+      d_queueReady.wait(lock, [this]() {
+        return d_stopping || !d_jobs.empty();
+      });
+      if (d_stopping) {
+        return;
+      }
+      job = std::move(d_jobs.front());
+      d_jobs.pop_front();
+    }
+    request.swap(job.payload);
+    const auto start(std::chrono::steady_clock::now());
+    handle(job.type, request, table, rows, response);
+    // record before replying, so a client that asks for the stats
+    // next sees its own requests
+    if (e_Tabulate == job.type) {
+      recordLatency(std::chrono::duration_cast<std::chrono::microseconds>
+                    (std::chrono::steady_clock::now() - start).count());
+    }
+    bool keep(true);
+    try {
+      sendFrame(job.fd, response);
+    }
+    catch (const std::exception &) {
+      // a broken connection ends the session
+      keep = false;
+    }
+    {
+      std::lock_guard<std::mutex> lock(d_queueMutex);
+      d_finished.emplace_back(job.fd, keep);
+    }
+    wake();
+  }
+}
+
+void
+ParseServer::handle(unsigned char type, const std::string &request, TableText &table,
+                    TableText::RowAndColumnList &rows, std::string &response)
+{
+  try {
+    if (e_Tabulate == type) {
+      std::size_t pos(0u);
+      const unsigned minCols(static_cast<unsigned>(readVarint(request, pos)));
+      const std::string text(normalizeLog(request.substr(pos)));
+      const HeaderList header(headerTags(text));
+      table.reset(qsoLines(text));
+      table.tabulate(minCols, rows);
+      beginFrame(response, e_OK);
+      appendVarint(response, header.size());
+      for (const HeaderTag &tag : header) {
+        appendString(response, tag.tag.data(), tag.tag.size());
+        appendString(response, tag.value.data(), tag.value.size());
+      }
+      // rows without columns carry nothing, and the client rejects them
+      const std::size_t numColumns(rows.empty() ? 0u : rows.front().size());
+      appendVarint(response, numColumns ? rows.size() : 0u);
+      appendVarint(response, numColumns);
+      for (const auto &row : rows) {
+        for (const std::string &cell : row) {
+          appendString(response, cell.data(), cell.size());
+        }
+      }
+    }
+    else if (e_Stats == type) {
+      const LatencyStats stats(getStats());
+      beginFrame(response, e_OK);
+      appendVarint(response, stats.requests);
+      appendVarint(response, stats.p50Microseconds);
+      appendVarint(response, stats.p90Microseconds);
+      appendVarint(response, stats.p99Microseconds);
+      appendVarint(response, stats.maxMicroseconds);
+    }
+    else {
+      throw std::runtime_error("Unknown request type");
+    }
+  }
+  catch (const std::exception &e) {
+    beginFrame(response, e_Error);
+    response.append(e.what());
+  }
+}
+
+void
+ParseServer::recordLatency(std::uint64_t microseconds)
+{
+  std::lock_guard<std::mutex> lock(d_statsMutex);
+  ++d_numRequests;
+  if (d_latencies.size() < s_latencyWindow) {
+    d_latencies.push_back(microseconds);
+  }
+  else {
+    d_latencies[d_nextLatency] = microseconds;
+    d_nextLatency = (d_nextLatency + 1u) % s_latencyWindow;
+  }
+}
+
+LatencyStats
+ParseServer::getStats() const
+{
+  std::vector<std::uint64_t> latencies;
+  LatencyStats result{ 0u, 0u, 0u, 0u, 0u };
+  {
+    std::lock_guard<std::mutex> lock(d_statsMutex);
+    latencies = d_latencies;
+    result.requests = d_numRequests;
+  }
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    const std::size_t last(latencies.size() - 1u);
+    result.p50Microseconds = latencies[(last * 50u) / 100u];
+    result.p90Microseconds = latencies[(last * 90u) / 100u];
+    result.p99Microseconds = latencies[(last * 99u) / 100u];
+    result.maxMicroseconds = latencies[last];
+  }
+  return result;
+}
+
+ParseClient::ParseClient(const std::string &socketPath)
+  : d_fd(::socket(AF_UNIX, SOCK_STREAM, 0))
+{
+  if (d_fd < 0) {
+    throwErrno("Unable to create socket");
+  }
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1u);
+  if (::connect(d_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+    const int err(errno);
+    ::close(d_fd);
+    throw std::system_error(err, std::generic_category(), "Unable to connect to " + socketPath);
+  }
+}
+
+ParseClient::ParseClient(unsigned short port)
+  : d_fd(::socket(AF_INET, SOCK_STREAM, 0))
+{
+  if (d_fd < 0) {
+    throwErrno("Unable to create socket");
+  }
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (::connect(d_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+    const int err(errno);
+    ::close(d_fd);
+    throw std::system_error(err, std::generic_category(),
+                            "Unable to connect to port " + std::to_string(port));
+  }
+}
+
+ParseClient::~ParseClient()
+{
+  ::close(d_fd);
+}
+
+std::string
+ParseClient::transact(unsigned char type, const std::string &payload)
+{
+  std::string frame;
+  frame.reserve(payload.size() + 5u);
+  beginFrame(frame, type);
+  frame.append(payload);
+  sendFrame(d_fd, frame);
+  std::string response;
+  unsigned char status;
+  try {
+    status = receiveFrame(d_fd, response, static_cast<std::size_t>(-1));
+  }
+  catch (const Disconnected &) {
+    throw std::runtime_error("The server closed the connection");
+  }
+  if (e_OK != status) {
+    throw std::runtime_error("Server error: " + response);
+  }
+  return response;
+}
+
+TabulatedLog
+ParseClient::tabulate(const std::string &log, unsigned minCols)
+{
+  std::string payload;
+  payload.reserve(log.size() + 5u);
+  appendVarint(payload, minCols);
+  payload.append(log);
+  const std::string response(transact(e_Tabulate, payload));
+  TabulatedLog result;
+  std::size_t pos(0u);
+  const std::uint64_t numTags(readVarint(response, pos));
+  for (std::uint64_t i = 0u; i < numTags; ++i) {
+    std::string tag(readString(response, pos));
+    const TagId id(tagIdFromName(tag));
+    result.header.push_back(HeaderTag{ std::move(tag), readString(response, pos), id });
+  }
+  const std::uint64_t numRows(readVarint(response, pos));
+  const std::uint64_t numColumns(readVarint(response, pos));
+  // every cell takes at least a byte, which bounds the rows before
+  // anything is allocated for them
+  const std::size_t remaining(response.size() - pos);
+  if ((numRows && !numColumns) || (numColumns > remaining) ||
+      (numColumns && (numRows > (remaining / numColumns)))) {
+    throw std::runtime_error("Truncated message");
+  }
+  result.rows.resize(static_cast<std::size_t>(numRows));
+  for (auto &row : result.rows) {
+    row.reserve(static_cast<std::size_t>(numColumns));
+    for (std::uint64_t col = 0u; col < numColumns; ++col) {
+      row.push_back(readString(response, pos));
+    }
+  }
+  return result;
+}
+
+LatencyStats
+ParseClient::stats()
+{
+  const std::string response(transact(e_Stats, std::string()));
+  std::size_t pos(0u);
+  LatencyStats result;
+  result.requests = readVarint(response, pos);
+  result.p50Microseconds = readVarint(response, pos);
+  result.p90Microseconds = readVarint(response, pos);
+  result.p99Microseconds = readVarint(response, pos);
+  result.maxMicroseconds = readVarint(response, pos);
+  return result;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file   cabserver.h
+ * @brief  A long running service that tabulates logs sent over a socket
+ *
+ * Starting a process per log pays for process start up and cold caches
+ * every time. A ParseServer keeps a pool of worker threads, each with
+ * a TableText and a result object whose memory is reused from one log
+ * to the next, and accepts logs over a Unix domain socket or a TCP
+ * port on the loopback interface.
+ *
+ * One I/O thread polls every connection and reads request frames as
+ * they arrive. Each complete frame goes to the worker pool, so a client
+ * holds a worker only while its request is being handled, and idle
+ * clients cost a file descriptor each rather than a thread.
+ *
+ * Every message in either direction is a frame: a four byte little
+ * endian length of the rest of the frame, followed by a one byte
+ * type or status and the payload. Lengths and counts inside payloads
+ * are unsigned LEB128 varints.
+ *
+ * Requests:
+ *  - e_Tabulate: varint minCols, then the log exactly as submitted
+ *  - e_Stats: no payload
+ *
+ * Responses:
+ *  - e_OK to e_Tabulate: varint number of header tags, each tag and
+ *    value as a varint length and the characters, then varint rows,
+ *    varint columns, and every cell row by row as a varint length and
+ *    the characters
+ *  - e_OK to e_Stats: varints for the number of requests and the 50th,
+ *    90th, 99th percentile and maximum latency in microseconds
+ *  - e_Error: the error message
+ */
+#ifndef __CABSERVER_H_LOADED__
+#define __CABSERVER_H_LOADED__
+#include "stringreg.h"
+#include "tabletext.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cab {
+
+/// The frame types of the protocol
+enum MessageType : unsigned char {
+  e_Tabulate = 1u,
+  e_Stats = 2u,
+  e_OK = 128u,
+  e_Error = 129u
+};
+
+/// Request latency percentiles reported by the server
+struct LatencyStats {
+  std::uint64_t requests;
+  std::uint64_t p50Microseconds;
+  std::uint64_t p90Microseconds;
+  std::uint64_t p99Microseconds;
+  std::uint64_t maxMicroseconds;
+};
+
+class ParseServer {
+public:
+  struct Options {
+    /// the path of a Unix domain socket to listen on
+    std::string socketPath;
+    /// if socketPath is empty, a TCP port on 127.0.0.1 (0 picks a free port)
+    unsigned short tcpPort = 0u;
+    /// the number of worker threads, which is the number of requests handled at once
+    unsigned threads = 4u;
+    /// the most clients connected at once. Clients beyond it are disconnected.
+    std::size_t maxConnections = 1024u;
+    /**
+     * milliseconds a client has to send a request after connecting or
+     * after its last response, and to read a response (0 waits forever)
+     */
+    unsigned idleTimeout = 30000u;
+    /// the largest request accepted
+    std::size_t maxRequestBytes = 64u << 20;
+    /// how logs are tabulated, including the limits that bound each worker
+    TableText::Options table;
+  };
+
+  /**
+   * @brief start listening and start the worker threads. A socket file
+   *        left at socketPath by a server that is no longer running is
+   *        replaced.
+   * @exception std::system_error  the socket could not be created, or
+   *                               socketPath is some other kind of file
+   *                               or belongs to a running server
+   */
+  explicit ParseServer(const Options &options);
+
+  /// stop the server
+  ~ParseServer();
+
+  /// the TCP port being listened on (0 for a Unix domain socket)
+  unsigned short getPort() const noexcept
+  {
+    return d_port;
+  }
+
+  /// the latency of the requests handled so far
+  LatencyStats getStats() const;
+
+  /**
+   * @brief stop accepting connections, disconnect the clients, and wait
+   *        for the threads to finish
+   */
+  void stop();
+private:
+  ParseServer(const ParseServer &) = delete;
+  ParseServer &operator=(const ParseServer &) = delete;
+
+  /// a complete request frame waiting for a worker
+  struct Job {
+    int fd;
+    unsigned char type;
+    std::string payload;
+  };
+
+  /// a client connection, which only the I/O thread changes
+  struct Connection {
+    /// the length and type of the frame being read
+    unsigned char header[5];
+    /// the payload read so far
+    std::string payload;
+    /// the payload length given by the header
+    std::size_t expected = 0u;
+    /// the bytes of the frame read so far
+    std::size_t received = 0u;
+    /// when the client connected or was last sent a response
+    std::chrono::steady_clock::time_point lastActive;
+    /// a worker has the request of this client
+    bool busy = false;
+  };
+
+  /// accept clients and read their requests until stop() is called
+  void ioLoop();
+
+  /// accept every waiting client
+  void acceptClient();
+
+  /// start reading requests from the client on @p fd
+  void addClient(int fd);
+
+  /**
+   * @brief read what the client on @p fd has sent, and queue its
+   *        request when the frame is complete
+   * @return false if the connection should be closed
+   */
+  bool readClient(int fd, Connection &conn);
+
+  void workerLoop();
+
+  /// handle one request and leave the response frame in @p response
+  void handle(unsigned char type, const std::string &request, TableText &table,
+              TableText::RowAndColumnList &rows, std::string &response);
+
+  /// make the I/O thread return from poll
+  void wake();
+
+  void recordLatency(std::uint64_t microseconds);
+
+  Options d_options;
+  int d_listenFd;
+  /// a pipe the workers write to when they finish a request
+  int d_wakeFds[2];
+  unsigned short d_port;
+  std::atomic<bool> d_stopping;
+  std::thread d_ioThread;
+  std::vector<std::thread> d_workers;
+  /// every connected client by file descriptor
+  std::map<int, Connection> d_connections;
+
+  /// requests waiting for a worker
+  std::mutex d_queueMutex;
+  std::condition_variable d_queueReady;
+  std::deque<Job> d_jobs;
+  /// connections whose request was answered, and whether to keep them open
+  std::vector<std::pair<int, bool>> d_finished;
+
+  /// the most recent request latencies in microseconds
+  mutable std::mutex d_statsMutex;
+  std::vector<std::uint64_t> d_latencies;
+  std::size_t d_nextLatency;
+  std::uint64_t d_numRequests;
+};
+
+/// The result of tabulating a log on the server
+struct TabulatedLog {
+  HeaderList header;
+  TableText::RowAndColumnList rows;
+};
+
+/**
+ * @brief A connection to a ParseServer
+ */
+class ParseClient {
+public:
+  /**
+   * @brief connect to the Unix domain socket @p socketPath
+   * @exception std::system_error  the connection failed
+   */
+  explicit ParseClient(const std::string &socketPath);
+
+  /**
+   * @brief connect to @p port on 127.0.0.1
+   * @exception std::system_error  the connection failed
+   */
+  explicit ParseClient(unsigned short port);
+
+  ~ParseClient();
+
+  /**
+   * @brief normalize and tabulate @p log on the server
+   * @exception std::runtime_error  the server reported an error
+   * @exception std::system_error   the connection failed
+   */
+  TabulatedLog tabulate(const std::string &log, unsigned minCols = 0u);
+
+  /// ask the server for its latency statistics
+  LatencyStats stats();
+private:
+  ParseClient(const ParseClient &) = delete;
+  ParseClient &operator=(const ParseClient &) = delete;
+
+  /// send a request and return the response payload
+  std::string transact(unsigned char type, const std::string &payload);
+
+  int d_fd;
+};
+}
+
+#endif /*  __CABSERVER_H_LOADED__ */
@@ -1,7 +1,36 @@
 #include "gtest/gtest.h"
+#include "cabserver.h"
+#include "cabwriter.h"
+#include "callindex.h"
+#include "compressed.h"
+#include "filemap.h"
+#include "fixedschema.h"
+#include "pipeline.h"
+#include "scorer.h"
 #include "stringreg.h"
+#include "tablecache.h"
+#include "tableexport.h"
 #include "tabletext.h"
+#include "timemerge.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <zlib.h>
 
 TEST(CabrilloBasics,NewlineTests)
 {
@@ -61,6 +90,68 @@ TEST(CabrilloBasics,RemoveXQSOLines)
   EXPECT_EQ(cab::removeXQSOLines(input), expected);
 }
 
+TEST(CabrilloBasics,HeaderTags)
+{
+  const std::string input("START-OF-LOG: 3.0\nCALLSIGN: W1AW \nQSO: 14332 PH 2020-10-03 1601 NS6T\nX-QSO: 14332 PH\nX-CQP-CALLSIGN: NS6T\nSOAPBOX:\n");
+  const cab::HeaderList tags(cab::headerTags(input));
+  ASSERT_EQ(4u, tags.size());
+  EXPECT_EQ("START-OF-LOG", tags[0].tag);
+  EXPECT_EQ("3.0", tags[0].value);
+  EXPECT_EQ("CALLSIGN", tags[1].tag);
+  EXPECT_EQ("W1AW", tags[1].value);
+  EXPECT_EQ("X-CQP-CALLSIGN", tags[2].tag);
+  EXPECT_EQ("NS6T", tags[2].value);
+  EXPECT_EQ("SOAPBOX", tags[3].tag);
+  EXPECT_EQ("", tags[3].value);
+}
+
+/// a scratch file that is removed at the end of a test
+class ScratchFile {
+public:
+  ScratchFile()
+  {
+    char name[] = "/tmp/cabtestXXXXXX";
+    const int fd(mkstemp(name));
+    if (fd >= 0) {
+      close(fd);
+    }
+    d_path = name;
+  }
+
+  /// a file whose name ends in @p suffix (e.g., ".gz")
+  explicit ScratchFile(const std::string &suffix)
+  {
+    std::string name("/tmp/cabtestXXXXXX" + suffix);
+    const int fd(mkstemps(&name[0], static_cast<int>(suffix.size())));
+    if (fd >= 0) {
+      close(fd);
+    }
+    d_path = name;
+  }
+
+  ScratchFile(const ScratchFile &) = delete;
+
+  ~ScratchFile()
+  {
+    std::remove(d_path.c_str());
+  }
+
+  const std::string &path() const
+  {
+    return d_path;
+  }
+
+  std::string contents() const
+  {
+    std::ifstream in(d_path, std::ios::binary);
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+  }
+private:
+  std::string d_path;
+};
+
 struct CabTableTest {
   std::string                text;
   unsigned                   numRows;
@@ -632,3 +723,1331 @@ TEST(CabrilloBasics, TableTests)
     }
   }
 }
+
+TEST(CabrilloBasics, TableCache)
+{
+  const cab::HeaderList header { { "CALLSIGN", "W1AW", cab::TagId::Callsign },
+    { "CONTEST", "CA-QSO-PARTY", cab::TagId::Contest } };
+  for(const auto &test : tableTests) {
+    cab::TableText table(test.text);
+    const cab::TableText::ColumnLayout layout(table.findLayout(11u));
+    const cab::TableText::RowAndColumnList rows(table.tabulate(layout));
+    EXPECT_EQ(table.tabulate(11u), rows);
+    ScratchFile scratch;
+    cab::writeTableCache(scratch.path(), test.text, header, layout, rows);
+    {
+      cab::TableCache cache(scratch.path());
+      EXPECT_TRUE(cache.isCurrent(test.text));
+      EXPECT_FALSE(cache.isCurrent(test.text + "\n"));
+      EXPECT_EQ(rows.size(), cache.getNumRows());
+      EXPECT_EQ(layout.size(), cache.getNumColumns());
+      const cab::TableText::ColumnLayout cachedLayout(cache.getLayout());
+      ASSERT_EQ(layout.size(), cachedLayout.size());
+      for(std::size_t i=0u; i < layout.size(); ++i) {
+        EXPECT_EQ(layout[i].begin, cachedLayout[i].begin);
+        EXPECT_EQ(layout[i].end, cachedLayout[i].end);
+      }
+      const cab::HeaderList cachedHeader(cache.getHeader());
+      ASSERT_EQ(header.size(), cachedHeader.size());
+      EXPECT_EQ("CONTEST", cachedHeader[1].tag);
+      EXPECT_EQ("CA-QSO-PARTY", cachedHeader[1].value);
+      EXPECT_EQ(rows[4][10], cache.getCell(4u, 10u).str());
+      EXPECT_EQ(rows, cache.getRows());
+    }
+    {
+      // flip one byte of cell data and the checksum must catch it
+      std::FILE *fp(std::fopen(scratch.path().c_str(), "r+b"));
+      ASSERT_NE(nullptr, fp);
+      std::fseek(fp, -16L, SEEK_END);
+      const int ch(std::fgetc(fp));
+      std::fseek(fp, -16L, SEEK_END);
+      std::fputc(ch ^ 0x20, fp);
+      std::fclose(fp);
+      EXPECT_THROW(cab::TableCache cache(scratch.path()), std::runtime_error);
+      EXPECT_NO_THROW(cab::TableCache cache(scratch.path(), false));
+    }
+    // a damaged offset is caught without the checksum
+    const auto align8 = [](std::size_t pos) {
+      return (pos + 7u) & ~static_cast<std::size_t>(7u);
+    };
+    const std::size_t tagSection(align8(64u + 8u*layout.size()));
+    std::size_t tagText(0u);
+    for(const auto &tag : header) {
+      tagText += tag.tag.size() + tag.value.size();
+    }
+    const std::size_t firstColumn(align8(align8(tagSection + 4u*(2u*header.size() + 1u) + tagText) +
+                                         8u*layout.size()));
+    for(const std::size_t offset : { tagSection + 4u, firstColumn + 8u }) {
+      cab::writeTableCache(scratch.path(), test.text, header, layout, rows);
+      std::FILE *fp(std::fopen(scratch.path().c_str(), "r+b"));
+      ASSERT_NE(nullptr, fp);
+      std::fseek(fp, static_cast<long>(offset + 3u), SEEK_SET);
+      std::fputc(0x7f, fp);
+      std::fclose(fp);
+      EXPECT_THROW(cab::TableCache cache(scratch.path(), false), std::runtime_error);
+    }
+  }
+}
+
+TEST(CabrilloBasics, TableExport)
+{
+  const std::string text("QSO: 7000 CW W1AW    \"Joe\", Sr\nQSO: 7001 CW K6RO    Ann\\\n");
+  cab::TableText table(text);
+  const cab::TableText::ColumnLayout layout(table.findLayout(4u));
+  {
+    ScratchFile scratch;
+    const int fd(open(scratch.path().c_str(), O_WRONLY | O_TRUNC));
+    ASSERT_LE(0, fd);
+    {
+      cab::OutputBuffer out(fd, 16u);
+      cab::TableExporter csv(out, cab::TableExporter::Format::CSV,
+                             std::vector<std::string> { "tag", "freq", "mode", "call", "name" });
+      csv.writeTable(table, layout);
+      EXPECT_EQ(2u, csv.getNumRows());
+      out.flush();
+    }
+    close(fd);
+    EXPECT_EQ("tag,freq,mode,call,name\nQSO:,7000,CW,W1AW,\"\"\"Joe\"\", Sr\"\nQSO:,7001,CW,K6RO,Ann\\\n",
+              scratch.contents());
+  }
+  {
+    ScratchFile scratch;
+    const int fd(open(scratch.path().c_str(), O_WRONLY | O_TRUNC));
+    ASSERT_LE(0, fd);
+    {
+      cab::OutputBuffer out(fd);
+      cab::TableExporter json(out, cab::TableExporter::Format::JSONLines);
+      json.writeTable(table.tabulate(layout));
+    }
+    close(fd);
+    EXPECT_EQ("[\"QSO:\",\"7000\",\"CW\",\"W1AW\",\"\\\"Joe\\\", Sr\"]\n[\"QSO:\",\"7001\",\"CW\",\"K6RO\",\"Ann\\\\\"]\n",
+              scratch.contents());
+  }
+  {
+    ScratchFile scratch;
+    const int fd(open(scratch.path().c_str(), O_WRONLY | O_TRUNC));
+    ASSERT_LE(0, fd);
+    {
+      cab::OutputBuffer out(fd);
+      cab::TableExporter tsv(out, cab::TableExporter::Format::TSV,
+                             std::vector<std::string> { "a", "b" });
+      tsv.writeRow(std::vector<std::string> { "x\ty", "back\\slash\n" });
+    }
+    close(fd);
+    EXPECT_EQ("a\tb\nx\\ty\tback\\\\slash\\n\n", scratch.contents());
+  }
+  for(const auto &test : tableTests) {
+    // the streaming and full table outputs must agree
+    cab::TableText t1(test.text);
+    const cab::TableText::ColumnLayout columns(t1.findLayout(11u));
+    ScratchFile streamed, whole;
+    const int fd1(open(streamed.path().c_str(), O_WRONLY | O_TRUNC));
+    const int fd2(open(whole.path().c_str(), O_WRONLY | O_TRUNC));
+    {
+      cab::OutputBuffer out1(fd1), out2(fd2);
+      cab::TableExporter e1(out1, cab::TableExporter::Format::CSV);
+      cab::TableExporter e2(out2, cab::TableExporter::Format::CSV);
+      e1.writeTable(t1, columns);
+      e2.writeTable(t1.tabulate(columns));
+      EXPECT_EQ(test.numRows, e1.getNumRows());
+    }
+    close(fd1);
+    close(fd2);
+    EXPECT_EQ(whole.contents(), streamed.contents());
+    EXPECT_NE(std::string::npos, streamed.contents().find("QSO:,21000,CW,2014-10-04,1632,W1AW,013,ORAN,DL5MU,5,Federal Republic of Germany\n"));
+  }
+}
+
+namespace {
+using CAQPSchema =
+  cab::FixedSchema<cab::SchemaColumn< 0,  4>,
+  cab::SchemaColumn< 5, 10, cab::Justify::Right, cab::ValueKind::Digits>,
+  cab::SchemaColumn<11, 13, cab::Justify::Left,  cab::ValueKind::Letters>,
+  cab::SchemaColumn<14, 24, cab::Justify::Left,  cab::ValueKind::Date>,
+  cab::SchemaColumn<25, 29, cab::Justify::Left,  cab::ValueKind::Digits>,
+  cab::SchemaColumn<30, 40, cab::Justify::Left,  cab::ValueKind::Callsign>,
+  cab::SchemaColumn<41, 44, cab::Justify::Right, cab::ValueKind::Digits>,
+  cab::SchemaColumn<45, 54, cab::Justify::Left,  cab::ValueKind::Letters>,
+  cab::SchemaColumn<55, 65, cab::Justify::Left,  cab::ValueKind::Callsign>,
+  cab::SchemaColumn<65, 69, cab::Justify::Right, cab::ValueKind::Digits>,
+  cab::SchemaColumn<70, cab::s_toEndOfLine>>;
+}
+
+TEST(CabrilloBasics, FixedSchema)
+{
+  for(const auto &test : tableTests) {
+    cab::TableText table(test.text);
+    EXPECT_TRUE(CAQPSchema::verify(test.text));
+    bool usedSchema(false);
+    const cab::TableText::RowAndColumnList rows(CAQPSchema::extract(table, &usedSchema));
+    EXPECT_TRUE(usedSchema);
+    EXPECT_EQ(table.tabulate(11u), rows);
+    EXPECT_EQ(11u, CAQPSchema::layout(table.getMaxWidth()).size());
+
+    // move the frequency one column to the left on one line
+    std::string shifted(test.text);
+    const std::size_t line(shifted.find("QSO: 21000 CW 2014-10-04 1632 W1AW       013"));
+    ASSERT_NE(std::string::npos, line);
+    shifted.replace(line, 11u, "QSO:21000  ");
+    EXPECT_FALSE(CAQPSchema::verify(shifted));
+    cab::TableText other(shifted);
+    CAQPSchema::extract(other, &usedSchema);
+    EXPECT_FALSE(usedSchema);
+  }
+}
+
+TEST(CabrilloBasics, Pipeline)
+{
+  const std::string header("START-OF-LOG: 3.0\r\n  CALLSIGN: W1AW\r\nCONTEST: CA-QSO-PARTY\r\n");
+  std::vector<ScratchFile> logs(3u);
+  std::vector<std::string> paths;
+  for(const auto &log : logs) {
+    std::ofstream out(log.path(), std::ios::binary);
+    out << header;
+    for(const char ch : tableTests[0].text) {
+      if ('\n' == ch) {
+        out << '\r';
+      }
+      out << ch;
+    }
+    out << "X-QSO: 21000 CW 2014-10-04 1609 W1AW       001 ORAN      KJ4AOM       5 KY\r\nEND-OF-LOG:\r\n";
+    paths.push_back(log.path());
+  }
+  paths.push_back("/nonexistent/cabrillo.log");
+  const cab::TableText::RowAndColumnList expected(cab::TableText(tableTests[0].text).tabulate(11u));
+  std::vector<std::size_t> order;
+  cab::Pipeline::Options options;
+  options.queueCapacity = 2u;
+  options.minCols = 11u;
+  cab::Pipeline pipeline([&](cab::LogJob &job) {
+    order.push_back(job.index);
+    EXPECT_EQ(paths[job.index], job.name);
+    if (job.index < logs.size()) {
+      EXPECT_EQ("", job.error);
+      ASSERT_EQ(4u, job.header.size());
+      EXPECT_EQ("CALLSIGN", job.header[1].tag);
+      EXPECT_EQ("W1AW", job.header[1].value);
+      EXPECT_EQ(expected, job.rows);
+      EXPECT_EQ(11u, job.layout.size());
+      EXPECT_EQ(cab::readFile(job.name), job.source);
+    }
+    else {
+      EXPECT_NE("", job.error);
+    }
+  }, options);
+  pipeline.run(paths);
+  EXPECT_EQ((std::vector<std::size_t> { 0u, 1u, 2u, 3u }), order);
+  ASSERT_EQ(static_cast<std::size_t>(cab::Pipeline::e_NumStages), pipeline.getStats().size());
+  for(const cab::StageStats &stats : pipeline.getStats()) {
+    EXPECT_EQ(paths.size(), stats.items);
+    EXPECT_LE(0.0, stats.utilization());
+    EXPECT_GE(1.0, stats.utilization());
+  }
+  EXPECT_STREQ("tabulate", pipeline.getStats()[cab::Pipeline::e_Tabulate].name);
+}
+
+TEST(CabrilloBasics, IncrementalEdits)
+{
+  using Edit = cab::TableText::LineEdit;
+  for(const auto &test : tableTests) {
+    const std::size_t firstEnd(test.text.find('\n'));
+    const std::string first(test.text, 0u, firstEnd);
+    const std::string widest("QSO: 14000 CW 2014-10-05 2047 W1AW       900 ORAN      K6M        714 Federal Republic of Germany and more");
+    const cab::TableText::EditList edits {
+      { Edit::Kind::Replace, 1u, "QSO: 28000 CW 2014-10-04 1614 W1AW       002 ORAN      N4JF         7 GA" },
+      { Edit::Kind::Remove, 0u, "" },
+      { Edit::Kind::Insert, 5u, first },
+      { Edit::Kind::Insert, test.numRows, widest },
+      { Edit::Kind::Remove, test.numRows, "" }
+    };
+    // apply the same edits to a copy of the text
+    std::vector<std::string> lines;
+    for(std::size_t cur = 0u; cur < test.text.size();) {
+      const std::size_t next(test.text.find('\n', cur));
+      lines.push_back(test.text.substr(cur, next - cur));
+      cur = next + 1u;
+    }
+    for(const Edit &edit : edits) {
+      if (Edit::Kind::Insert == edit.kind) {
+        lines.insert(lines.begin() + edit.row, edit.text);
+      }
+      else if (Edit::Kind::Remove == edit.kind) {
+        lines.erase(lines.begin() + edit.row);
+      }
+      else {
+        lines[edit.row] = edit.text;
+      }
+    }
+    std::string edited;
+    for(const std::string &line : lines) {
+      edited += line + "\n";
+    }
+    cab::TableText fresh(edited);
+
+    cab::TableText table(test.text);
+    cab::TableText::ColumnLayout layout(table.findLayout(11u));
+    cab::TableText::RowAndColumnList rows(table.tabulate(layout));
+    EXPECT_TRUE(table.retabulate(edits, 11u, layout, rows));
+    EXPECT_EQ(edited, table.getText());
+    EXPECT_EQ(fresh.getNumRows(), table.getNumRows());
+    EXPECT_EQ(fresh.getMaxWidth(), table.getMaxWidth());
+    EXPECT_EQ(fresh.tabulate(11u), rows);
+    EXPECT_EQ("GA", rows.at(0).at(10));
+
+    EXPECT_THROW(table.applyEdits(cab::TableText::EditList { { Edit::Kind::Remove, test.numRows, "" } }),
+                 std::out_of_range);
+    EXPECT_THROW(table.applyEdits(cab::TableText::EditList { { Edit::Kind::Replace, 0u, "a\nb" } }),
+                 std::invalid_argument);
+
+    // a bad edit after good ones leaves the text and the tabulation as they were
+    const std::size_t maxWidth(table.getMaxWidth());
+    EXPECT_THROW(table.retabulate(cab::TableText::EditList { { Edit::Kind::Remove, 0u, "" },
+                                                             { Edit::Kind::Insert, 0u, widest },
+                                                             { Edit::Kind::Replace, 1u, "a\nb" } },
+                                  11u, layout, rows),
+                 std::invalid_argument);
+    EXPECT_EQ(edited, table.getText());
+    EXPECT_EQ(maxWidth, table.getMaxWidth());
+    EXPECT_EQ(fresh.tabulate(11u), rows);
+    EXPECT_EQ(rows, table.tabulate(layout));
+
+    // removing the widest line narrows the counts
+    table.applyEdits(cab::TableText::EditList { { Edit::Kind::Insert, 2u, widest } });
+    EXPECT_EQ(widest.size(), table.getMaxWidth());
+    table.applyEdits(cab::TableText::EditList { { Edit::Kind::Remove, 2u, "" } });
+    EXPECT_EQ(fresh.getMaxWidth(), table.getMaxWidth());
+    EXPECT_EQ(fresh.tabulate(11u), table.tabulate(11u));
+  }
+}
+
+TEST(CabrilloBasics, UnterminatedLastLine)
+{
+  // an unterminated last line isn't treated as padded with spaces
+  const cab::TableText::RowAndColumnList expected {
+    { "AB", "CD", "EF" },
+    { "AB", "CD", "" },
+    { "AB", "", "" }
+  };
+  cab::TableText table("AB CD EF\nAB CD\nAB");
+  EXPECT_EQ(3u, table.getNumRows());
+  EXPECT_EQ(expected, table.tabulate(3u));
+
+  // once edited the text is terminated, so the last line is padded
+  using Edit = cab::TableText::LineEdit;
+  table.applyEdits(cab::TableText::EditList { { Edit::Kind::Replace, 0u, "AB CD EF" } });
+  cab::TableText fresh("AB CD EF\nAB CD\nAB\n");
+  EXPECT_EQ(fresh.getText(), table.getText());
+  EXPECT_EQ(fresh.tabulate(), table.tabulate());
+  table.applyEdits(cab::TableText::EditList { { Edit::Kind::Remove, 0u, "" } });
+  EXPECT_EQ(cab::TableText("AB CD\nAB\n").tabulate(), table.tabulate());
+}
+
+TEST(CabrilloBasics, PlainASCII)
+{
+  std::string text(200u, 'x');
+  EXPECT_TRUE(cab::isPlainASCII(text.data(), text.size()));
+  for(std::size_t pos : { 0u, 7u, 8u, 63u, 64u, 130u, 199u }) {
+    std::string tabbed(text), accented(text);
+    tabbed[pos] = '\t';
+    accented[pos] = '\xc3';
+    EXPECT_FALSE(cab::isPlainASCII(tabbed.data(), tabbed.size()));
+    EXPECT_FALSE(cab::isPlainASCII(accented.data(), accented.size()));
+    EXPECT_TRUE(cab::isPlainASCII(tabbed.data(), pos));
+  }
+}
+
+namespace {
+/// replace runs of spaces that end at a tab stop with a tab
+std::string
+unexpand(const std::string &line, std::size_t tabStop)
+{
+  std::string result;
+  std::size_t spaces(0u);
+  for(std::size_t col = 0u; col < line.size(); ++col) {
+    if (' ' == line[col]) {
+      ++spaces;
+      if (0u == ((col + 1u) % tabStop)) {
+        result.append((spaces > 1u) ? std::string(1u, '\t') : std::string(spaces, ' '));
+        spaces = 0u;
+      }
+    }
+    else {
+      result.append(spaces, ' ');
+      spaces = 0u;
+      result.push_back(line[col]);
+    }
+  }
+  return result.append(spaces, ' ');
+}
+
+void
+replaceAll(std::string &str, const std::string &from, const std::string &to)
+{
+  for(std::size_t pos = str.find(from); std::string::npos != pos;
+      pos = str.find(from, pos + to.size())) {
+    str.replace(pos, from.size(), to);
+  }
+}
+}
+
+TEST(CabrilloBasics, TabsAndUTF8)
+{
+  for(const auto &test : tableTests) {
+    cab::TableText plain(test.text);
+    EXPECT_TRUE(plain.isPlainText());
+    cab::TableText::RowAndColumnList expected(plain.tabulate(11u));
+    for(auto &row : expected) {
+      for(auto &field : row) {
+        replaceAll(field, "ORAN", "\xc3\x96RAN");
+        replaceAll(field, "Poland", "Polska \xf0\x9f\x87\xb5");
+      }
+    }
+    for(std::size_t tabStop : { 4u, 8u }) {
+      std::string fancy;
+      for(std::size_t cur = 0u; cur < test.text.size();) {
+        const std::size_t next(test.text.find('\n', cur));
+        fancy += unexpand(test.text.substr(cur, next - cur), tabStop) + "\n";
+        cur = next + 1u;
+      }
+      replaceAll(fancy, "ORAN", "\xc3\x96RAN");
+      replaceAll(fancy, "Poland", "Polska \xf0\x9f\x87\xb5");
+      ASSERT_NE(std::string::npos, fancy.find('\t'));
+      cab::TableText::Options options;
+      options.tabStop = tabStop;
+      cab::TableText table(fancy, options);
+      EXPECT_FALSE(table.isPlainText());
+      EXPECT_EQ(test.numRows, table.getNumRows());
+      EXPECT_EQ(test.maxWidth, table.getMaxWidth());
+      EXPECT_EQ(expected, table.tabulate(11u));
+      bool usedSchema(true);
+      EXPECT_EQ(expected, CAQPSchema::extract(table, &usedSchema));
+      EXPECT_FALSE(usedSchema);
+    }
+  }
+}
+
+TEST(CabrilloBasics, ResetAndReuse)
+{
+  const std::string small("QSO: 7000 CW K6RO   1\nQSO: 7001 CW W1AW  22\n");
+  cab::TableText table(small);
+  cab::TableText::RowAndColumnList result;
+  for(const auto &test : tableTests) {
+    table.reset(test.text);
+    cab::TableText fresh(test.text);
+    EXPECT_EQ(fresh.getNumRows(), table.getNumRows());
+    EXPECT_EQ(fresh.getMaxWidth(), table.getMaxWidth());
+    table.tabulate(11u, result);
+    EXPECT_EQ(fresh.tabulate(11u), result);
+    const std::vector<std::string> *const firstRow(result.data());
+    const std::string *const firstField(result[0].data());
+
+    table.reset(small.c_str());
+    EXPECT_EQ(2u, table.getNumRows());
+    table.tabulate(4u, result);
+    EXPECT_EQ(cab::TableText(small).tabulate(4u), result);
+
+    // the same object and result again reuse their memory
+    table.reset(test.text);
+    table.tabulate(table.findLayout(11u), result);
+    EXPECT_EQ(fresh.tabulate(11u), result);
+    EXPECT_EQ(firstRow, result.data());
+    EXPECT_EQ(firstField, result[0].data());
+  }
+}
+
+TEST(CabrilloBasics, ColumnTypes)
+{
+  using Type = cab::TableText::ColumnType;
+  const std::vector<Type> expected {
+    Type::Mixed, Type::Numeric, Type::Text, Type::Date, Type::Time, Type::Callsign,
+    Type::Numeric, Type::Text, Type::Callsign, Type::Numeric, Type::Text
+  };
+  cab::TableText::Options options;
+  options.profileColumns = true;
+  for(const auto &test : tableTests) {
+    cab::TableText plain(test.text);
+    EXPECT_THROW(plain.inferColumnTypes(plain.findLayout(11u)), std::logic_error);
+
+    cab::TableText table(test.text, options);
+    const cab::TableText::ColumnLayout layout(table.findLayout(11u));
+    EXPECT_EQ(plain.tabulate(11u), table.tabulate(layout));
+    EXPECT_EQ(expected, table.inferColumnTypes(layout));
+    const cab::TableText::ColumnProfile serial(table.getProfile(layout[6]));
+    EXPECT_EQ(3u * test.numRows, serial.digits);
+    EXPECT_EQ(0u, serial.others);
+    EXPECT_EQ(test.numRows, static_cast<unsigned>(table.getCharCounts(cab::TableText::e_Dash).at(18)));
+
+    // the same answers with tabs and UTF-8, and after edits
+    std::string fancy(unexpand(test.text.substr(0u, test.text.find('\n')), 8u) + "\n" +
+                      test.text.substr(test.text.find('\n') + 1u));
+    replaceAll(fancy, "Poland", "Polska \xf0\x9f\x87\xb5");
+    cab::TableText other(fancy, options);
+    EXPECT_FALSE(other.isPlainText());
+    EXPECT_EQ(expected, other.inferColumnTypes(other.findLayout(11u)));
+    using Edit = cab::TableText::LineEdit;
+    table.applyEdits(cab::TableText::EditList { { Edit::Kind::Remove, 0u, "" },
+      { Edit::Kind::Insert, 0u, test.text.substr(0u, test.text.find('\n')) } });
+    EXPECT_EQ(expected, table.inferColumnTypes(layout));
+    EXPECT_EQ(3u * test.numRows, table.getProfile(layout[6]).digits);
+  }
+}
+
+TEST(CabrilloBasics, Scorer)
+{
+  EXPECT_EQ(cab::e_20m, cab::bandFromFrequency("14025"));
+  EXPECT_EQ(cab::e_6m, cab::bandFromFrequency("50"));
+  EXPECT_EQ(cab::e_UnknownBand, cab::bandFromFrequency("1.2G"));
+  EXPECT_THROW(cab::parseScoringRules("COLUMNS: 1 2\n"), std::invalid_argument);
+  EXPECT_THROW(cab::parseScoringRules("BONUS: 100\n"), std::invalid_argument);
+
+  const cab::ScoringRules rules(cab::parseScoringRules(
+    "COLUMNS: 1 2 8 10\nPOINTS: CW 3\nPOINTS: PH 2\nMULT-SCOPE: BAND\nDUPE-SCOPE: BAND-MODE\n"
+    "MULTIPLIERS: AL AK AZ AR CA CO CT DE FL GA HI ID IL IN IA KS KY LA ME MD MA MI MN MS MO\n"
+    "MULTIPLIERS: MT NE NV NH NJ NM NY NC ND OH OK OR PA RI SC SD TN TX UT VT VA WA WV WI WY\n"
+    "MULTIPLIERS: AB BC MR ON ORAN SCLA RIVE\n"
+    "MULTIPLIER: Federal Republic of Germany\n"));
+  const cab::Scorer scorer(rules);
+  EXPECT_EQ(0, scorer.multiplierId("al"));
+  EXPECT_LE(0, scorer.multiplierId("FEDERAL REPUBLIC OF GERMANY"));
+  EXPECT_EQ(-1, scorer.multiplierId("Poland"));
+
+  std::vector<cab::TableText::RowAndColumnList> logs;
+  for(const auto &test : tableTests) {
+    logs.push_back(cab::TableText(test.text).tabulate(11u));
+  }
+  // add a log with a duplicate and a bad line
+  logs.push_back(logs[0]);
+  logs.back().push_back(logs.back().front());
+  logs.back().push_back(std::vector<std::string> { "QSO:", "1.2G", "CW" });
+  std::vector<const cab::TableText::RowAndColumnList *> pointers;
+  for(const auto &log : logs) {
+    pointers.push_back(&log);
+  }
+  const std::vector<cab::Score> scores(scorer.scoreAll(pointers, 3u));
+  ASSERT_EQ(logs.size(), scores.size());
+  for(std::size_t i = 0u; i < logs.size(); ++i) {
+    // score the simple way to compare
+    std::set<std::string> contacts, mults;
+    std::uint64_t points(0u);
+    for(const auto &row : logs[i]) {
+      if ((row.size() == 11u) && contacts.insert(row[8] + row[1] + row[2]).second) {
+        points += ("CW" == row[2]) ? 3u : 2u;
+        if (scorer.multiplierId(row[10]) >= 0) {
+          mults.insert(cab::bandName(cab::bandFromFrequency(row[1])) + row[10]);
+        }
+      }
+    }
+    const cab::Score expected(scorer.score(logs[i]));
+    EXPECT_EQ(contacts.size(), scores[i].qsos);
+    EXPECT_EQ(points, scores[i].qsoPoints);
+    EXPECT_EQ(mults.size(), scores[i].multipliers);
+    EXPECT_EQ(points * mults.size(), scores[i].claimed);
+    EXPECT_EQ(expected.claimed, scores[i].claimed);
+  }
+  EXPECT_EQ(1u, scores.back().dupes);
+  EXPECT_EQ(1u, scores.back().invalid);
+
+  // case doesn't matter to dupes, points or multipliers
+  cab::TableText::RowAndColumnList mixed(logs[0]);
+  for(auto &row : mixed) {
+    for(const std::size_t col : { 2u, 8u, 10u }) {
+      std::transform(row[col].begin(), row[col].end(), row[col].begin(), ::tolower);
+    }
+  }
+  mixed.push_back(logs[0].front());
+  const cab::Score lower(scorer.score(mixed));
+  EXPECT_EQ(scores.front().qsos, lower.qsos);
+  EXPECT_EQ(1u, lower.dupes);
+  EXPECT_EQ(scores.front().claimed, lower.claimed);
+
+  // an error in a worker thread reaches the caller
+  pointers.insert(pointers.begin() + 1, nullptr);
+  EXPECT_THROW(scorer.scoreAll(pointers, 3u), std::invalid_argument);
+}
+
+TEST(CabrilloBasics, ParseServer)
+{
+  std::string log("START-OF-LOG: 3.0\r\nCALLSIGN: W1AW\r\n");
+  for(const char ch : tableTests[0].text) {
+    if ('\n' == ch) {
+      log.push_back('\r');
+    }
+    log.push_back(ch);
+  }
+  log += "END-OF-LOG:\r\n";
+  const cab::TableText::RowAndColumnList expected(cab::TableText(tableTests[0].text).tabulate(11u));
+  cab::ParseServer::Options options;
+  options.socketPath = "/tmp/cabtests-" + std::to_string(::getpid()) + ".sock";
+  options.threads = 2u;
+  {
+    cab::ParseServer server(options);
+    std::vector<std::thread> clients;
+    for(unsigned i = 0u; i < 4u; ++i) {
+      clients.emplace_back([&]() {
+        cab::ParseClient client(options.socketPath);
+        for(unsigned j = 0u; j < 5u; ++j) {
+          const cab::TabulatedLog result(client.tabulate(log, 11u));
+          EXPECT_EQ(expected, result.rows);
+          ASSERT_EQ(3u, result.header.size());
+          EXPECT_EQ("W1AW", result.header[1].value);
+        }
+      });
+    }
+    for(std::thread &client : clients) {
+      client.join();
+    }
+    cab::ParseClient client(options.socketPath);
+    EXPECT_THROW(client.tabulate(log, 50u), std::runtime_error);
+    const cab::LatencyStats stats(client.stats());
+    EXPECT_EQ(21u, stats.requests);
+    EXPECT_LE(stats.p50Microseconds, stats.p99Microseconds);
+    EXPECT_LE(stats.p99Microseconds, stats.maxMicroseconds);
+    // a second server doesn't take over the socket of a running one
+    EXPECT_THROW(cab::ParseServer second(options), std::system_error);
+    EXPECT_EQ(expected, client.tabulate(log, 11u).rows);
+  }
+  EXPECT_THROW(cab::ParseClient client(options.socketPath), std::system_error);
+
+  // a file that isn't a socket is left alone
+  std::ofstream(options.socketPath) << "not a socket\n";
+  EXPECT_THROW(cab::ParseServer server(options), std::system_error);
+  EXPECT_EQ(0, ::access(options.socketPath.c_str(), F_OK));
+  std::remove(options.socketPath.c_str());
+
+  // the socket of a server that didn't clean up is replaced
+  {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, options.socketPath.c_str());
+    const int fd(::socket(AF_UNIX, SOCK_STREAM, 0));
+    ASSERT_EQ(0, ::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    ::close(fd);
+    cab::ParseServer server(options);
+    cab::ParseClient client(options.socketPath);
+    EXPECT_EQ(expected, client.tabulate(log, 11u).rows);
+  }
+
+  // a response claiming rows without columns, or more cells than it
+  // holds, is rejected before anything is allocated for it
+  for(const std::string &counts : { std::string("\x02\x00", 2u), std::string("\xff\xff\x03\x02", 4u) }) {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, options.socketPath.c_str());
+    const int listenFd(::socket(AF_UNIX, SOCK_STREAM, 0));
+    ASSERT_EQ(0, ::bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, ::listen(listenFd, 1));
+    std::thread fake([listenFd, &counts]() {
+      const int fd(::accept(listenFd, nullptr, nullptr));
+      char request[256];
+      ASSERT_LT(0, ::recv(fd, request, sizeof(request), 0));
+      std::string response(1u, static_cast<char>(counts.size() + 4u));
+      response += std::string(3u, '\0') + static_cast<char>(cab::e_OK) + '\0' + counts + "ab";
+      ASSERT_EQ(static_cast<ssize_t>(response.size()), ::send(fd, response.data(), response.size(), 0));
+      ::close(fd);
+    });
+    cab::ParseClient client(options.socketPath);
+    EXPECT_THROW(client.tabulate("QSO:", 0u), std::runtime_error);
+    fake.join();
+    ::close(listenFd);
+    std::remove(options.socketPath.c_str());
+  }
+
+  options.socketPath.clear();
+  {
+    cab::ParseServer server(options);
+    ASSERT_NE(0u, server.getPort());
+    cab::ParseClient client(server.getPort());
+    EXPECT_EQ(expected, client.tabulate(log, 11u).rows);
+
+    // a request is read in pieces as it arrives
+    std::string bigText, bigLog("START-OF-LOG: 3.0\r\n");
+    while (bigText.size() < (1u << 18)) {
+      bigText += tableTests[0].text;
+    }
+    for(const char ch : bigText) {
+      if ('\n' == ch) {
+        bigLog.push_back('\r');
+      }
+      bigLog.push_back(ch);
+    }
+    bigLog += "END-OF-LOG:\r\n";
+    EXPECT_EQ(cab::TableText(bigText).tabulate(11u), client.tabulate(bigLog, 11u).rows);
+
+    // idle clients don't hold the workers, so many more clients than
+    // threads can be connected at once
+    std::vector<std::unique_ptr<cab::ParseClient>> idle;
+    for(unsigned i = 0u; i < 4u*options.threads; ++i) {
+      idle.emplace_back(new cab::ParseClient(server.getPort()));
+    }
+    for(auto it = idle.rbegin(); it != idle.rend(); ++it) {
+      EXPECT_EQ(expected, (*it)->tabulate(log, 11u).rows);
+    }
+    EXPECT_EQ(expected, client.tabulate(log, 11u).rows);
+  }
+
+  // clients beyond the limit and clients that stay idle are disconnected
+  options.maxConnections = 1u;
+  options.idleTimeout = 200u;
+  cab::ParseServer server(options);
+  cab::ParseClient first(server.getPort());
+  EXPECT_EQ(expected, first.tabulate(log, 11u).rows);
+  cab::ParseClient second(server.getPort());
+  EXPECT_THROW(second.tabulate(log, 11u), std::runtime_error);
+  EXPECT_EQ(expected, first.tabulate(log, 11u).rows);
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  EXPECT_THROW(first.tabulate(log, 11u), std::runtime_error);
+  cab::ParseClient third(server.getPort());
+  EXPECT_EQ(expected, third.tabulate(log, 11u).rows);
+}
+
+TEST(CabrilloBasics, Limits)
+{
+  const std::string &text(tableTests[0].text);
+  const std::size_t numRows(cab::TableText(text).getNumRows());
+  const cab::TableText::RowAndColumnList expected(cab::TableText(text).tabulate(11u));
+  cab::TableText::Options options;
+  options.maxBytes = text.size() - 1u;
+  try {
+    cab::TableText table(text, options);
+    FAIL() << "the byte limit was ignored";
+  }
+  catch (const cab::LimitError &e) {
+    EXPECT_EQ(cab::LimitError::Limit::Bytes, e.which());
+    EXPECT_EQ(text.size(), e.value());
+  }
+  options.maxBytes = 0u;
+  options.maxRows = numRows - 1u;
+  EXPECT_THROW(cab::TableText(text, options), cab::LimitError);
+  options.maxRows = numRows;
+  cab::TableText limited(text, options);
+  EXPECT_EQ(expected, limited.tabulate(11u));
+  EXPECT_THROW(limited.applyEdits(cab::TableText::EditList {
+    { cab::TableText::LineEdit::Kind::Insert, 0u, "QSO:" }
+  }), cab::LimitError);
+  EXPECT_EQ(numRows, limited.getNumRows());
+  EXPECT_EQ(expected, limited.tabulate(11u));
+
+  // one enormous line among normal rows
+  std::string wide(text);
+  const std::size_t secondRow(wide.find('\n') + 1u);
+  wide.insert(secondRow, std::string(1u << 20, 'X') + "\n");
+  options.maxRows = 0u;
+  options.maxWidth = 200u;
+  try {
+    cab::TableText table(wide, options);
+    FAIL() << "the width limit was ignored";
+  }
+  catch (const cab::LimitError &e) {
+    EXPECT_EQ(cab::LimitError::Limit::Width, e.which());
+    EXPECT_EQ(std::size_t(1u) << 20, e.value());
+  }
+  cab::TableText reused(text, options);
+  EXPECT_THROW(reused.reset(wide), cab::LimitError);
+  EXPECT_EQ(0u, reused.getNumRows());
+  EXPECT_EQ("", reused.getText());
+
+  options.clipWideLines = true;
+  cab::TableText clipped(wide, options);
+  EXPECT_EQ(numRows + 1u, clipped.getNumRows());
+  EXPECT_EQ(cab::TableText(text).getMaxWidth(), clipped.getMaxWidth());
+  EXPECT_EQ(std::vector<std::size_t> { 1u }, clipped.getOutlierRows());
+  cab::TableText::RowAndColumnList rows(clipped.tabulate(11u));
+  ASSERT_EQ(numRows + 1u, rows.size());
+  rows.erase(rows.begin() + 1);
+  EXPECT_EQ(expected, rows);
+  clipped.applyEdits(cab::TableText::EditList {
+    { cab::TableText::LineEdit::Kind::Remove, 1u, "" }
+  });
+  EXPECT_TRUE(clipped.getOutlierRows().empty());
+  EXPECT_EQ(expected, clipped.tabulate(11u));
+}
+
+TEST(CabrilloBasics, Segments)
+{
+  for(const auto &test : tableTests) {
+    cab::TableText table(test.text);
+    const cab::TableText::SegmentList single(table.findSegments(test.numColumns));
+    ASSERT_EQ(1u, single.size());
+    EXPECT_EQ(test.numRows, single[0].numRows);
+    EXPECT_EQ(table.findLayout(test.numColumns), single[0].layout);
+  }
+  const std::string &text(tableTests[0].text);
+  const cab::TableText::RowAndColumnList expected(cab::TableText(text).tabulate(11u));
+
+  // the same QSOs written by another program with other column widths
+  static const std::size_t widths[] = { 6u, 7u, 4u, 12u, 6u, 12u, 5u, 10u, 11u, 6u };
+  std::string other;
+  for(const auto &row : expected) {
+    for(std::size_t col = 0u; col < row.size(); ++col) {
+      if (9u == col) {
+        // the exchange number is right justified
+        other.append(widths[col] - 1u - row[col].size(), ' ');
+        other += row[col] + " ";
+      }
+      else {
+        other += row[col];
+        if (col < (sizeof(widths)/sizeof(widths[0]))) {
+          other.append(std::max(widths[col], row[col].size() + 1u) - row[col].size(), ' ');
+        }
+      }
+    }
+    other.push_back('\n');
+  }
+  cab::TableText merged(text + other + text);
+  const cab::TableText::SegmentList segments(merged.findSegments(11u));
+  ASSERT_EQ(3u, segments.size());
+  for(std::size_t i = 0u; i < segments.size(); ++i) {
+    EXPECT_EQ(i * expected.size(), segments[i].firstRow);
+    EXPECT_EQ(expected.size(), segments[i].numRows);
+    EXPECT_EQ(11u, segments[i].layout.size());
+  }
+  EXPECT_EQ(segments[0].layout, segments[2].layout);
+  EXPECT_NE(segments[0].layout, segments[1].layout);
+  for(const unsigned threads : { 1u, 3u }) {
+    const cab::TableText::SegmentedRows result(merged.tabulateSegments(11u, threads));
+    ASSERT_EQ(3u * expected.size(), result.rows.size());
+    for(std::size_t row = 0u; row < result.rows.size(); ++row) {
+      EXPECT_EQ(expected[row % expected.size()], result.rows[row]);
+      EXPECT_EQ(row / expected.size(), result.rowSegments[row]);
+    }
+  }
+}
+
+namespace {
+void
+appendLittleEndian(std::string &out, std::uint32_t value, unsigned numBytes)
+{
+  for(unsigned i = 0u; i < numBytes; ++i) {
+    out.push_back(static_cast<char>((value >> (8u*i)) & 0xffu));
+  }
+}
+
+/// build a zip archive of @p files: the first is stored, the rest deflated
+std::string
+zipArchive(const std::vector<std::pair<std::string, std::string>> &files)
+{
+  std::string archive, directory;
+  for(std::size_t i = 0u; i < files.size(); ++i) {
+    const std::string &name(files[i].first), &contents(files[i].second);
+    std::string data(contents);
+    const unsigned method(i ? 8u : 0u);
+    if (method) {
+      z_stream stream = z_stream();
+      deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+      data.resize(deflateBound(&stream, contents.size()));
+      stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(contents.data()));
+      stream.avail_in = static_cast<uInt>(contents.size());
+      stream.next_out = reinterpret_cast<Bytef *>(&data[0]);
+      stream.avail_out = static_cast<uInt>(data.size());
+      deflate(&stream, Z_FINISH);
+      data.resize(stream.total_out);
+      deflateEnd(&stream);
+    }
+    const std::uint32_t crc(crc32(0u, reinterpret_cast<const Bytef *>(contents.data()),
+                                  static_cast<uInt>(contents.size())));
+    const std::uint32_t offset(static_cast<std::uint32_t>(archive.size()));
+    std::string common;
+    appendLittleEndian(common, 20u, 2u);       // version needed
+    appendLittleEndian(common, 0u, 2u);        // flags
+    appendLittleEndian(common, method, 2u);
+    appendLittleEndian(common, 0u, 4u);        // time and date
+    appendLittleEndian(common, crc, 4u);
+    appendLittleEndian(common, static_cast<std::uint32_t>(data.size()), 4u);
+    appendLittleEndian(common, static_cast<std::uint32_t>(contents.size()), 4u);
+    appendLittleEndian(common, static_cast<std::uint32_t>(name.size()), 2u);
+    appendLittleEndian(common, 0u, 2u);        // extra length
+    appendLittleEndian(archive, 0x04034b50u, 4u);
+    archive += common + name + data;
+    appendLittleEndian(directory, 0x02014b50u, 4u);
+    appendLittleEndian(directory, 20u, 2u);    // version made by
+    directory += common;
+    appendLittleEndian(directory, 0u, 4u);     // comment length, disk
+    appendLittleEndian(directory, 0u, 2u);     // internal attributes
+    appendLittleEndian(directory, 0u, 4u);     // external attributes
+    appendLittleEndian(directory, offset, 4u);
+    directory += name;
+  }
+  const std::uint32_t directoryOffset(static_cast<std::uint32_t>(archive.size()));
+  archive += directory;
+  appendLittleEndian(archive, 0x06054b50u, 4u);
+  appendLittleEndian(archive, 0u, 4u);         // disk numbers
+  appendLittleEndian(archive, static_cast<std::uint32_t>(files.size()), 2u);
+  appendLittleEndian(archive, static_cast<std::uint32_t>(files.size()), 2u);
+  appendLittleEndian(archive, static_cast<std::uint32_t>(directory.size()), 4u);
+  appendLittleEndian(archive, directoryOffset, 4u);
+  appendLittleEndian(archive, 0u, 2u);         // comment length
+  return archive;
+}
+}
+
+TEST(CabrilloBasics, CompressedInput)
+{
+  const std::string log("START-OF-LOG: 3.0\r\nCALLSIGN: W1AW\r\n" + tableTests[0].text +
+                        "END-OF-LOG:\r\n");
+  EXPECT_EQ(cab::Compression::Gzip, cab::compressionFromPath("logs/w1aw.LOG.GZ"));
+  EXPECT_EQ(cab::Compression::Zip, cab::compressionFromPath("w1aw.zip"));
+  EXPECT_EQ(cab::Compression::None, cab::compressionFromPath("w1aw.log"));
+
+  // two gzip members, as written by appending to a .gz file
+  ScratchFile gzipped(".gz");
+  for(const std::size_t half : { std::size_t(0u), log.size() / 2u }) {
+    gzFile out(gzopen(gzipped.path().c_str(), half ? "ab" : "wb"));
+    ASSERT_NE(nullptr, out);
+    const std::string part(half ? log.substr(half) : log.substr(0u, log.size() / 2u));
+    gzwrite(out, part.data(), static_cast<unsigned>(part.size()));
+    gzclose(out);
+  }
+  EXPECT_EQ(log, cab::readLogFile(gzipped.path()));
+  EXPECT_THROW(cab::readLogFile(gzipped.path(), log.size() - 1u), cab::LimitError);
+
+  ScratchFile zipped(".zip");
+  {
+    std::ofstream out(zipped.path(), std::ios::binary);
+    out << zipArchive({ { "w1aw.log", log.substr(0u, 1000u) }, { "logs/", "" },
+      { "rest.log", log.substr(1000u) }
+    });
+  }
+  cab::InflateReader reader(zipped.path(), cab::Compression::Zip);
+  EXPECT_EQ(log.size(), reader.sizeHint());
+  std::string small;
+  char buffer[7];
+  while (const std::size_t got = reader.read(buffer, sizeof(buffer))) {
+    small.append(buffer, got);
+    // an empty read neither blocks nor ends the data
+    EXPECT_EQ(0u, reader.read(buffer, 0u));
+  }
+  EXPECT_EQ(log, small);
+  cab::InflateReader gzipReader(gzipped.path(), cab::Compression::Gzip);
+  EXPECT_EQ(0u, gzipReader.read(buffer, 0u));
+  small.clear();
+  while (const std::size_t got = gzipReader.read(buffer, sizeof(buffer))) {
+    small.append(buffer, got);
+  }
+  EXPECT_EQ(log, small);
+
+  std::vector<std::string> rows;
+  cab::Pipeline::Options options;
+  options.minCols = 11u;
+  cab::Pipeline pipeline([&](cab::LogJob &job) {
+    EXPECT_EQ("", job.error);
+    EXPECT_EQ(log, job.source);
+    EXPECT_EQ(cab::TableText(tableTests[0].text).tabulate(11u), job.rows);
+  }, options);
+  pipeline.run({ gzipped.path(), zipped.path() });
+
+  // a damaged file is an error, not a crash
+  ScratchFile damaged(".gz");
+  {
+    std::string contents(gzipped.contents());
+    contents.resize(contents.size() / 2u);
+    std::ofstream out(damaged.path(), std::ios::binary);
+    out << contents;
+  }
+  EXPECT_THROW(cab::readLogFile(damaged.path()), std::runtime_error);
+
+  // a directory entry whose name runs past the directory
+  ScratchFile longName(".zip");
+  {
+    std::string contents(zipped.contents());
+    const std::size_t entry(contents.rfind("PK\x01\x02"));
+    ASSERT_NE(std::string::npos, entry);
+    contents[entry + 28u] = contents[entry + 29u] = '\xff';
+    std::ofstream out(longName.path(), std::ios::binary);
+    out << contents;
+  }
+  EXPECT_THROW(cab::InflateReader(longName.path(), cab::Compression::Zip), std::runtime_error);
+
+  // a recorded size far beyond what the data can hold is not trusted
+  ScratchFile bigSize(".zip");
+  {
+    std::string contents(zipped.contents());
+    const std::size_t entry(contents.rfind("PK\x01\x02"));
+    ASSERT_NE(std::string::npos, entry);
+    std::fill(contents.begin() + entry + 24, contents.begin() + entry + 28, '\xff');
+    std::ofstream out(bigSize.path(), std::ios::binary);
+    out << contents;
+  }
+  cab::InflateReader bigReader(bigSize.path(), cab::Compression::Zip);
+  EXPECT_GE(1032u*bigSize.contents().size(), bigReader.sizeHint());
+  EXPECT_EQ(log, cab::readLogFile(bigSize.path()));
+  ScratchFile bigGzip(".gz");
+  {
+    std::string contents(gzipped.contents());
+    std::fill(contents.end() - 4, contents.end(), '\xff');
+    std::ofstream out(bigGzip.path(), std::ios::binary);
+    out << contents;
+  }
+  EXPECT_GE(1032u*gzipped.contents().size(),
+            cab::InflateReader(bigGzip.path(), cab::Compression::Gzip).sizeHint());
+}
+
+TEST(CabrilloBasics, TagRecognizer)
+{
+  for(int id = static_cast<int>(cab::TagId::StartOfLog);
+      id <= static_cast<int>(cab::TagId::XQso); ++id) {
+    const std::string name(cab::tagName(static_cast<cab::TagId>(id)));
+    ASSERT_NE("", name);
+    EXPECT_EQ(static_cast<cab::TagId>(id), cab::tagIdFromName(name));
+    std::string lower(name + ": value");
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    std::size_t length(0u);
+    EXPECT_EQ(static_cast<cab::TagId>(id),
+              cab::recognizeTag(lower.data(), lower.data() + lower.size(), &length));
+    EXPECT_EQ(name.size(), length);
+  }
+  const auto recognize = [](const std::string &line) {
+    return cab::recognizeTag(line.data(), line.data() + line.size());
+  };
+  EXPECT_EQ(cab::TagId::Extension, recognize("X-CQ-ZONE: 5"));
+  EXPECT_EQ(cab::TagId::Unknown, recognize("CATEGORY-BANDS: ALL"));
+  EXPECT_EQ(cab::TagId::Unknown, recognize("CALL:"));
+  EXPECT_EQ(cab::TagId::None, recognize("CALLSIGN"));
+  EXPECT_EQ(cab::TagId::None, recognize("CALL SIGN: W1AW"));
+  EXPECT_EQ(cab::TagId::None, recognize("-QSO:"));
+  EXPECT_EQ(cab::TagId::None, recognize("X--QSO:"));
+  EXPECT_EQ(cab::TagId::None, recognize("QSO-: 21000"));
+  EXPECT_EQ(cab::TagId::None, recognize(" QSO: 21000"));
+  EXPECT_EQ(cab::TagId::None, recognize(""));
+  EXPECT_EQ(cab::TagId::None, cab::tagIdFromName("CALLSIGN:"));
+
+  const std::string log(cab::normalizeLog("START-OF-LOG: 3.0\r\n  Callsign: W1AW\r\n"
+                                          "X-QSO: 21000 CW\r\nx-qso: 14000 CW\r\n"
+                                          "SOAPBOX: a long\r\nline\r\nQSO: 7000 CW\r\n"));
+  EXPECT_EQ("START-OF-LOG: 3.0\nCallsign: W1AW\nSOAPBOX: a longline\nQSO: 7000 CW\n", log);
+  const cab::HeaderList header(cab::headerTags(log));
+  ASSERT_EQ(3u, header.size());
+  EXPECT_EQ(cab::TagId::StartOfLog, header[0].id);
+  const cab::HeaderTag *callsign(cab::findTag(header, cab::TagId::Callsign));
+  ASSERT_NE(nullptr, callsign);
+  EXPECT_EQ("Callsign", callsign->tag);
+  EXPECT_EQ("W1AW", callsign->value);
+  EXPECT_EQ(nullptr, cab::findTag(header, cab::TagId::Contest));
+}
+
+TEST(CabrilloBasics, CallsignIndex)
+{
+  // make a few logs from the table test by taking some of its QSOs
+  const cab::TableText::RowAndColumnList qsos(cab::TableText(tableTests[0].text).tabulate(11u));
+  std::vector<cab::TableText::RowAndColumnList> logs(5u);
+  for(std::size_t row = 0u; row < qsos.size(); ++row) {
+    for(std::size_t i = 0u; i < logs.size(); ++i) {
+      if (0u == (row % (i + 1u))) {
+        logs[i].push_back(qsos[row]);
+      }
+    }
+  }
+  logs[2].push_back(std::vector<std::string> { "QSO:", "14025" });
+  logs[3].front()[1] = "7025";
+  // the postings the index should find, collected the simple way
+  std::map<std::string, cab::CallsignIndex::PostingList> expected;
+  const auto expect = [&expected](std::uint32_t log, const cab::TableText::RowAndColumnList &rows) {
+    for(std::size_t row = 0u; row < rows.size(); ++row) {
+      if (rows[row].size() > 8u) {
+        expected[rows[row][8]].push_back(cab::CallsignIndex::Posting {
+          log, static_cast<std::uint32_t>(row), cab::bandFromFrequency(rows[row][1]) });
+      }
+    }
+  };
+  const auto check = [&expected](const cab::CallsignIndex &index) {
+    for(const auto &call : expected) {
+      cab::CallsignIndex::PostingList postings(call.second);
+      std::sort(postings.begin(), postings.end(),
+      [](const cab::CallsignIndex::Posting &a, const cab::CallsignIndex::Posting &b) {
+        return (a.log < b.log) || ((a.log == b.log) && (a.row < b.row));
+      });
+      EXPECT_EQ(postings, index.find(call.first)) << call.first;
+    }
+    std::vector<std::string> calls;
+    for(const auto &call : expected) {
+      calls.push_back(call.first);
+    }
+    EXPECT_EQ(calls, index.calls("*"));
+  };
+
+  cab::CallsignIndex::Options options;
+  options.shards = 7u;
+  cab::CallsignIndex index(options);
+  std::vector<cab::CallsignIndex::LogRows> added;
+  for(std::size_t i = 1u; i < logs.size(); ++i) {
+    const std::uint32_t id(static_cast<std::uint32_t>(10u*i));
+    added.push_back(cab::CallsignIndex::LogRows{ id, &logs[i] });
+    expect(id, logs[i]);
+  }
+  index.addLogs(added, 3u);
+  EXPECT_EQ(logs.size() - 1u, index.getNumLogs());
+  check(index);
+  EXPECT_THROW(index.addLog(10u, logs[0]), std::invalid_argument);
+  EXPECT_THROW(index.addLogs({ { 5u, &logs[0] }, { 5u, &logs[1] } }), std::invalid_argument);
+  EXPECT_FALSE(index.hasLog(5u));
+
+  ScratchFile scratch;
+  index.save(scratch.path());
+  {
+    cab::CallsignIndex saved(scratch.path());
+    EXPECT_TRUE(saved.hasLog(10u));
+    EXPECT_FALSE(saved.hasLog(5u));
+    check(saved);
+    // a late log with a smaller id goes on top of the file
+    saved.addLog(5u, logs[0]);
+    expect(5u, logs[0]);
+    check(saved);
+    EXPECT_TRUE(saved.hasLog(5u));
+    saved.save(scratch.path());
+  }
+  cab::CallsignIndex merged(scratch.path());
+  EXPECT_EQ(logs.size(), merged.getNumLogs());
+  check(merged);
+
+  // logs added out of order of id, in memory
+  cab::CallsignIndex descending(options);
+  descending.addLog(40u, logs[4]);
+  descending.addLogs({ { 30u, &logs[3] }, { 20u, &logs[2] } }, 2u);
+  descending.addLogs({ { 5u, &logs[0] }, { 10u, &logs[1] } });
+  check(descending);
+
+  const cab::CallsignIndex::PostingList dl5mu(merged.find("dl5mu"));
+  ASSERT_FALSE(dl5mu.empty());
+  EXPECT_EQ(5u, dl5mu.front().log);
+  EXPECT_EQ(4u, dl5mu.front().row);
+  EXPECT_EQ(cab::e_15m, dl5mu.front().band);
+  EXPECT_TRUE(merged.find("DL5MU", cab::e_160m).empty());
+  EXPECT_EQ((std::vector<std::uint32_t> { 5u, 10u, 30u }), merged.findLogs("DL5MU", cab::e_15m));
+  EXPECT_TRUE(merged.find("DL5").empty());
+  for(const std::string &call : merged.calls("DL*")) {
+    EXPECT_EQ(0u, call.find("DL"));
+  }
+  std::size_t numDL(0u);
+  for(const auto &call : expected) {
+    numDL += (0u == call.first.find("DL")) ? call.second.size() : 0u;
+  }
+  EXPECT_EQ(numDL, merged.find("dl*").size());
+
+  {
+    // flip one byte of posting data and the checksum must catch it
+    std::FILE *fp(std::fopen(scratch.path().c_str(), "r+b"));
+    ASSERT_NE(nullptr, fp);
+    std::fseek(fp, -4L, SEEK_END);
+    const int ch(std::fgetc(fp));
+    std::fseek(fp, -4L, SEEK_END);
+    std::fputc(ch ^ 0x20, fp);
+    std::fclose(fp);
+    EXPECT_THROW(cab::CallsignIndex corrupt(scratch.path()), std::runtime_error);
+  }
+  {
+    // offsets that would read outside the file are caught without the hash
+    merged.save(scratch.path());
+    std::FILE *fp(std::fopen(scratch.path().c_str(), "r+b"));
+    ASSERT_NE(nullptr, fp);
+    // the second callsign offset, after the header and five log ids
+    std::fseek(fp, 68L, SEEK_SET);
+    const std::uint32_t offset(0xffffffu);
+    std::fwrite(&offset, sizeof(offset), 1u, fp);
+    std::fclose(fp);
+    EXPECT_THROW(cab::CallsignIndex corrupt(scratch.path(), false), std::runtime_error);
+  }
+}
+
+TEST(CabrilloBasics, TimeMerge)
+{
+  EXPECT_LT(cab::qsoTimeKey("2014-10-04", "2359"), cab::qsoTimeKey("2014-10-05", "0000"));
+  EXPECT_LT(cab::qsoTimeKey("2014-10-04", "1609"), cab::qsoTimeKey("2014-10-04", "160901"));
+  EXPECT_EQ(0u, cab::qsoTimeKey("2014-10-04", "2460"));
+  EXPECT_EQ(0u, cab::qsoTimeKey("10/04/2014", "1609"));
+
+  // deal the QSOs of the table test out to three logs
+  const cab::TableText::RowAndColumnList qsos(cab::TableText(tableTests[0].text).tabulate(11u));
+  std::vector<cab::TableText::RowAndColumnList> logs(3u);
+  for(std::size_t row = 0u; row < qsos.size(); ++row) {
+    logs[row % logs.size()].push_back(qsos[row]);
+  }
+  // put a few rows of one log slightly out of order
+  ASSERT_LT(40u, logs[1].size());
+  std::swap(logs[1][3], logs[1][5]);
+  std::swap(logs[1][20], logs[1][21]);
+  std::rotate(logs[1].begin() + 30u, logs[1].begin() + 33u, logs[1].begin() + 34u);
+  std::vector<const cab::TableText::RowAndColumnList *> pointers;
+  for(const auto &log : logs) {
+    pointers.push_back(&log);
+  }
+  std::vector<cab::TimeMerge::Row> expected;
+  for(std::size_t log = 0u; log < logs.size(); ++log) {
+    for(std::size_t row = 0u; row < logs[log].size(); ++row) {
+      expected.push_back(cab::TimeMerge::Row{ log, row,
+                                              cab::qsoTimeKey(logs[log][row][3], logs[log][row][4]) });
+    }
+  }
+  std::sort(expected.begin(), expected.end(),
+  [](const cab::TimeMerge::Row &a, const cab::TimeMerge::Row &b) {
+    return std::make_tuple(a.time, a.log, a.row) < std::make_tuple(b.time, b.log, b.row);
+  });
+  cab::TimeMerge::Options options;
+  options.window = 4u;
+  cab::TimeMerge merge(pointers, options);
+  cab::TimeMerge::Row row;
+  std::size_t i(0u);
+  while (merge.next(row)) {
+    ASSERT_LT(i, expected.size());
+    EXPECT_EQ(expected[i].log, row.log);
+    EXPECT_EQ(expected[i].row, row.row);
+    EXPECT_EQ(expected[i].time, row.time);
+    EXPECT_EQ(logs[row.log][row.row], merge.cells(row));
+    ++i;
+  }
+  EXPECT_EQ(expected.size(), i);
+  EXPECT_EQ(0u, merge.getNumOutOfWindow());
+  EXPECT_LE(3u, merge.getNumReordered());
+
+  // a row far from its place is returned late and counted, and a row
+  // without a time stays after the row before it
+  std::rotate(logs[2].begin() + 5u, logs[2].begin() + 6u, logs[2].begin() + 26u);
+  logs[2][10][4] = "noon";
+  cab::TimeMerge far(pointers, options);
+  std::vector<std::size_t> log2;
+  std::uint64_t lastTime(0u);
+  while (far.next(row)) {
+    if (2u == row.log) {
+      log2.push_back(row.row);
+      if (row.row != 25u) {
+        EXPECT_LE(lastTime, row.time);
+        lastTime = row.time;
+      }
+    }
+  }
+  ASSERT_EQ(logs[2].size(), log2.size());
+  EXPECT_EQ(1u, far.getNumOutOfWindow());
+  EXPECT_EQ(9u, log2[9]);
+  EXPECT_EQ(10u, log2[10]);
+  // it can only move as far as the window reaches
+  EXPECT_EQ(25u, log2[22]);
+  EXPECT_EQ(24u, log2[25]);
+}
+
+TEST(CabrilloBasics, CabrilloWriter)
+{
+  cab::TableText::Options options;
+  options.profileColumns = true;
+  const cab::TableText table(tableTests[0].text, options);
+  const cab::TableText::ColumnLayout layout(table.findLayout(11u));
+  const cab::TableText::RowAndColumnList rows(table.tabulate(layout));
+  const cab::HeaderList header { { "callsign", "W1AW", cab::TagId::Callsign },
+    { "Contest", "CA-QSO-PARTY", cab::TagId::Contest },
+    { "X-Q-LOCATION", "ORAN", cab::TagId::Extension },
+    { "SOAPBOX", "", cab::TagId::Soapbox } };
+
+  const cab::CabrilloWriter::ColumnFormat detected(cab::CabrilloWriter::columnFormat(table, layout));
+  ASSERT_EQ(11u, detected.size());
+  EXPECT_EQ(cab::Justify::Left, detected[0].justify);
+  EXPECT_EQ(cab::Justify::Right, detected[1].justify);
+  EXPECT_EQ(cab::Justify::Left, detected[2].justify);
+  EXPECT_EQ(cab::Justify::Right, detected[9].justify);
+  const cab::CabrilloWriter::ColumnFormat fromRows(cab::CabrilloWriter::columnFormat(rows));
+  ASSERT_EQ(11u, fromRows.size());
+  for(std::size_t col = 0u; col < fromRows.size(); ++col) {
+    // the time is all digits too, but it's always four wide
+    if (cab::Justify::Right == detected[col].justify) {
+      EXPECT_EQ(cab::Justify::Right, fromRows[col].justify) << col;
+    }
+  }
+
+  for(const auto &format : { cab::CabrilloWriter::ColumnFormat(), detected }) {
+    ScratchFile scratch;
+    const int fd(open(scratch.path().c_str(), O_WRONLY | O_TRUNC));
+    ASSERT_LE(0, fd);
+    {
+      cab::OutputBuffer out(fd, 256u);
+      cab::CabrilloWriter writer(out, format);
+      writer.writeLog(header, rows);
+      EXPECT_EQ(1u, writer.getNumLogs());
+      out.flush();
+    }
+    close(fd);
+    const std::string written(scratch.contents());
+    EXPECT_EQ(0u, written.find("START-OF-LOG: 3.0\r\nCALLSIGN: W1AW\r\nCONTEST: CA-QSO-PARTY\r\n"
+                               "X-Q-LOCATION: ORAN\r\nSOAPBOX:\r\nQSO: 28000 CW 2014-10-04 1609 "));
+    EXPECT_EQ(written.size() - 13u, written.find("END-OF-LOG:\r\n"));
+    EXPECT_EQ(std::string::npos, written.find(" \r\n"));
+
+    // every QSO line has its columns in the same places
+    const std::string text(cab::normalizeLog(written));
+    const std::string qsos(cab::qsoLines(text));
+    std::istringstream lines(qsos);
+    std::string line, first;
+    while (std::getline(lines, line)) {
+      if (first.empty()) {
+        first = line;
+      }
+      EXPECT_EQ(first.find(" 2014-"), line.find(" 2014-")) << line;
+      EXPECT_EQ(first.find(" W1AW "), line.find(" W1AW ")) << line;
+    }
+
+    const cab::HeaderList readBack(cab::headerTags(text));
+    ASSERT_EQ(header.size() + 2u, readBack.size());
+    EXPECT_EQ("W1AW", readBack[1].value);
+    EXPECT_EQ(cab::TagId::Extension, readBack[3].id);
+    EXPECT_EQ(rows, cab::TableText(qsos).tabulate(11u));
+  }
+
+  // a row with only empty cells has no spaces, even in padded columns
+  ScratchFile scratch;
+  const int fd(open(scratch.path().c_str(), O_WRONLY | O_TRUNC));
+  ASSERT_LE(0, fd);
+  {
+    cab::OutputBuffer out(fd, 256u);
+    cab::CabrilloWriter writer(out, detected);
+    writer.writeRow(std::vector<std::string>(11u));
+    writer.writeRow(cab::TableText::SpanRow(11u, cab::TableText::FieldSpan{ "", 0u }));
+    writer.writeRow(std::vector<std::string> { "QSO:", "7000", "", "" });
+    out.flush();
+  }
+  close(fd);
+  EXPECT_EQ("\r\n\r\nQSO: " + std::string(detected[1].width - 4u, ' ') + "7000\r\n",
+            scratch.contents());
+}
+
+TEST(CabrilloBasics, RankLayouts)
+{
+  const cab::TableText table(tableTests[0].text);
+  const cab::TableText::CandidateList candidates(table.rankLayouts());
+  ASSERT_LT(1u, candidates.size());
+  EXPECT_EQ(table.findLayout(11u), candidates.front().layout);
+  EXPECT_EQ(candidates.front().layout, table.findBestLayout());
+  for(std::size_t i = 0u; i < candidates.size(); ++i) {
+    const cab::TableText::LayoutCandidate &candidate(candidates[i]);
+    for(const double measure : { candidate.straddles, candidate.empties, candidate.merges }) {
+      EXPECT_LE(0.0, measure);
+      EXPECT_GE(1.0, measure);
+    }
+    EXPECT_DOUBLE_EQ(candidate.straddles + candidate.empties + candidate.merges,
+                     candidate.score);
+    for(std::size_t j = 0u; j < i; ++j) {
+      EXPECT_LE(candidates[j].score, candidate.score);
+      EXPECT_FALSE(candidates[j].layout == candidate.layout);
+    }
+  }
+  EXPECT_EQ(0.0, candidates.front().straddles);
+  for(const auto &candidate : table.rankLayouts(12u)) {
+    EXPECT_LE(12u, candidate.layout.size());
+  }
+  EXPECT_THROW(table.rankLayouts(40u), std::out_of_range);
+
+  // one callsign running into the gap before the next column makes the
+  // first layout with enough columns merge them, but not the best one
+  std::string text(tableTests[0].text);
+  const std::size_t pos(text.find("N4JF         7"));
+  ASSERT_NE(std::string::npos, pos);
+  text.replace(pos, 14u, "N4JF/VE3ABCD 7");
+  const cab::TableText overflow(text);
+  EXPECT_EQ(10u, overflow.findLayout().size());
+  const cab::TableText::ColumnLayout best(overflow.findBestLayout());
+  ASSERT_EQ(11u, best.size());
+  const cab::TableText::RowAndColumnList expected(table.tabulate(11u));
+  const cab::TableText::RowAndColumnList rows(overflow.tabulate(best));
+  ASSERT_EQ(expected.size(), rows.size());
+  for(std::size_t row = 0u; row < rows.size(); ++row) {
+    if (1u != row) {
+      EXPECT_EQ(expected[row], rows[row]) << row;
+    }
+  }
+}
@@ -0,0 +1,202 @@
+#include "cabwriter.h"
+#include "tagid.h"
+
+#include <algorithm>
+#include <cctype>
+
+using namespace cab;
+
+namespace {
+const char s_spaces[] = "                                                                ";
+
+bool
+isDigits(const std::string &cell) noexcept
+{
+  return !cell.empty() &&
+         std::all_of(cell.begin(), cell.end(), [](char ch) {
+    return (ch >= '0') && (ch <= '9');
+  });
+}
+
+/// the number of cells up to the last one that isn't empty
+template <typename Row, typename Length>
+std::size_t
+usedCells(const Row &row, Length length)
+{
+  std::size_t count(row.size());
+  while (count && !length(row[count - 1u])) {
+    --count;
+  }
+  return count;
+}
+}
+
+CabrilloWriter::ColumnFormat
+CabrilloWriter::columnFormat(const TableText::ColumnLayout            &layout,
+                             const std::vector<TableText::ColumnType> &types)
+{
+  ColumnFormat result;
+  result.reserve(layout.size());
+  for (std::size_t col = 0u; col < layout.size(); ++col) {
+    // a range usually includes the space that ends the column
+    const std::size_t width(layout[col].end - layout[col].begin);
+    const bool numeric((col < types.size()) && (TableText::ColumnType::Numeric == types[col]));
+    result.push_back(Column{ (width > 1u) ? (width - 1u) : width,
+                             numeric ? Justify::Right : Justify::Left });
+  }
+  return result;
+}
+
+CabrilloWriter::ColumnFormat
+CabrilloWriter::columnFormat(const TableText &table, const TableText::ColumnLayout &layout)
+{
+  return columnFormat(layout, table.inferColumnTypes(layout));
+}
+
+CabrilloWriter::ColumnFormat
+CabrilloWriter::columnFormat(const TableText::RowAndColumnList &rows)
+{
+  ColumnFormat result;
+  std::vector<bool> digits;
+  for (const auto &row : rows) {
+    if (row.size() > result.size()) {
+      result.resize(row.size(), Column{ 0u, Justify::Left });
+      digits.resize(row.size(), true);
+    }
+    for (std::size_t col = 0u; col < row.size(); ++col) {
+      result[col].width = std::max(result[col].width, row[col].size());
+      if (digits[col] && !row[col].empty() && !isDigits(row[col])) {
+        digits[col] = false;
+      }
+    }
+  }
+  for (std::size_t col = 0u; col < result.size(); ++col) {
+    result[col].justify = digits[col] ? Justify::Right : Justify::Left;
+  }
+  return result;
+}
+
+void
+CabrilloWriter::fitColumns(ColumnFormat &format, const TableText::RowAndColumnList &rows)
+{
+  for (const auto &row : rows) {
+    if (row.size() > format.size()) {
+      format.resize(row.size(), Column{ 0u, Justify::Left });
+    }
+    for (std::size_t col = 0u; col < row.size(); ++col) {
+      format[col].width = std::max(format[col].width, row[col].size());
+    }
+  }
+}
+
+CabrilloWriter::CabrilloWriter(OutputBuffer &out)
+  : CabrilloWriter(out, ColumnFormat())
+{
+}
+
+CabrilloWriter::CabrilloWriter(OutputBuffer &out, const ColumnFormat &format)
+  : d_out(out),
+    d_baseFormat(format),
+    d_format(format),
+    d_numLogs(0u)
+{
+}
+
+void
+CabrilloWriter::writeSpaces(std::size_t count)
+{
+  while (count > 0u) {
+    const std::size_t chunk(std::min(count, sizeof(s_spaces) - 1u));
+    d_out.append(s_spaces, chunk);
+    count -= chunk;
+  }
+}
+
+void
+CabrilloWriter::endLine()
+{
+  d_out.append("\r\n", 2u);
+}
+
+void
+CabrilloWriter::writeCell(std::size_t col, const char *data, std::size_t len, bool last)
+{
+  if (col > 0u) {
+    d_out.put(' ');
+  }
+  const std::size_t pad((col < d_format.size()) && (d_format[col].width > len) ?
+                        (d_format[col].width - len) : 0u);
+  if ((col < d_format.size()) && (Justify::Right == d_format[col].justify)) {
+    writeSpaces(pad);
+    d_out.append(data, len);
+  }
+  else {
+    d_out.append(data, len);
+    if (!last) {
+      writeSpaces(pad);
+    }
+  }
+}
+
+void
+CabrilloWriter::writeRow(const std::vector<std::string> &row)
+{
+  // empty cells at the end of the row would only leave trailing
+  // spaces, and a row with no cells at all is an empty line
+  const std::size_t used(usedCells(row, [](const std::string &cell) {
+    return cell.size();
+  }));
+  for (std::size_t col = 0u; col < used; ++col) {
+    writeCell(col, row[col].data(), row[col].size(), (col + 1u) == used);
+  }
+  endLine();
+}
+
+void
+CabrilloWriter::writeRow(const TableText::SpanRow &row)
+{
+  const std::size_t used(usedCells(row, [](const TableText::FieldSpan &cell) {
+    return cell.length;
+  }));
+  for (std::size_t col = 0u; col < used; ++col) {
+    writeCell(col, row[col].data, row[col].length, (col + 1u) == used);
+  }
+  endLine();
+}
+
+void
+CabrilloWriter::writeTag(const HeaderTag &tag)
+{
+  for (const char ch : tag.tag) {
+    d_out.put(static_cast<char>(std::toupper(static_cast<unsigned char>(ch))));
+  }
+  d_out.put(':');
+  if (!tag.value.empty()) {
+    d_out.put(' ');
+    d_out.append(tag.value);
+  }
+  endLine();
+}
+
+void
+CabrilloWriter::writeLog(const HeaderList &header, const TableText::RowAndColumnList &rows)
+{
+  d_format = d_baseFormat.empty() ? columnFormat(rows) : d_baseFormat;
+  fitColumns(d_format, rows);
+
+  const HeaderTag *const start(findTag(header, TagId::StartOfLog));
+  writeTag(HeaderTag{ "START-OF-LOG", start ? start->value : std::string("3.0"),
+                      TagId::StartOfLog });
+  for (const HeaderTag &tag : header) {
+    const TagId id((TagId::None == tag.id) ? tagIdFromName(tag.tag) : tag.id);
+    if ((TagId::StartOfLog != id) && (TagId::EndOfLog != id)) {
+      writeTag(tag);
+    }
+  }
+  for (const auto &row : rows) {
+    writeRow(row);
+  }
+  d_out.append("END-OF-LOG:", 11u);
+  endLine();
+  ++d_numLogs;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file   cabwriter.h
+ * @brief  Write normalized Cabrillo logs with aligned columns
+ *
+ * After adjudication, corrected logs are published in a canonical
+ * form: START-OF-LOG first, one upper case tag per header line, the
+ * QSO lines in aligned columns, and END-OF-LOG last. Every column of
+ * the QSO lines has one width for the whole log. Numeric columns such
+ * as frequencies and serial numbers are right justified, and the
+ * others are left justified.
+ *
+ * The text goes straight into an OutputBuffer, so a whole season of
+ * logs can be written with one large buffer and few system calls.
+ * Tabulating the output with TableText gives back the same fields.
+ */
+#ifndef __CABWRITER_H_LOADED__
+#define __CABWRITER_H_LOADED__
+#include "fixedschema.h"
+#include "outputbuffer.h"
+#include "stringreg.h"
+#include "tabletext.h"
+
+#include <string>
+#include <vector>
+
+namespace cab {
+
+class CabrilloWriter {
+public:
+  /// how one column of the QSO lines is written
+  struct Column {
+    std::size_t width;          ///< characters, not counting the space before it
+    Justify justify;
+  };
+
+  using ColumnFormat = std::vector<Column>;
+
+  /**
+   * @brief the format of the columns found in a table. The widths
+   *        come from @p layout, and Numeric columns in @p types are
+   *        right justified.
+   */
+  static ColumnFormat
+  columnFormat(const TableText::ColumnLayout          &layout,
+               const std::vector<TableText::ColumnType> &types);
+
+  /**
+   * @brief the format of the columns of a table that was tabulated
+   *        with Options::profileColumns set
+   */
+  static ColumnFormat
+  columnFormat(const TableText &table, const TableText::ColumnLayout &layout);
+
+  /**
+   * @brief the format of tabulated rows on their own. A column is
+   *        right justified when all of its cells are digits.
+   */
+  static ColumnFormat columnFormat(const TableText::RowAndColumnList &rows);
+
+  /// widen the columns of @p format so every cell of @p rows fits
+  static void fitColumns(ColumnFormat &format, const TableText::RowAndColumnList &rows);
+
+  /// write to @p out, taking the column format from the rows of each log
+  explicit CabrilloWriter(OutputBuffer &out);
+
+  /// write to @p out with the columns of @p format, widened as needed
+  CabrilloWriter(OutputBuffer &out, const ColumnFormat &format);
+
+  /**
+   * @brief write a whole log: START-OF-LOG, the other tags of
+   *        @p header in order, the QSO lines and END-OF-LOG. Lines
+   *        end with CR LF.
+   */
+  void writeLog(const HeaderList &header, const TableText::RowAndColumnList &rows);
+
+  /// write one header line with the tag in upper case
+  void writeTag(const HeaderTag &tag);
+
+  /**
+   * @brief write one QSO line with the current column format. Empty
+   *        cells at the end are left out, so a row whose cells are all
+   *        empty is written as an empty line.
+   */
+  void writeRow(const std::vector<std::string> &row);
+
+  /// write one QSO line with the current column format
+  void writeRow(const TableText::SpanRow &row);
+
+  const ColumnFormat &getFormat() const noexcept
+  {
+    return d_format;
+  }
+
+  /// the number of logs written so far
+  std::size_t getNumLogs() const noexcept
+  {
+    return d_numLogs;
+  }
+private:
+  CabrilloWriter() = delete;
+
+  void writeCell(std::size_t col, const char *data, std::size_t len, bool last);
+
+  void writeSpaces(std::size_t count);
+
+  void endLine();
+
+  OutputBuffer &d_out;
+  /// the format given to the constructor, empty to use the rows of each log
+  const ColumnFormat d_baseFormat;
+  /// the format of the log being written
+  ColumnFormat d_format;
+  std::size_t d_numLogs;
+};
+}
+
+#endif /*  __CABWRITER_H_LOADED__ */
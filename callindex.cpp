@@ -0,0 +1,655 @@
+#include "callindex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+using namespace cab;
+
+const std::uint32_t CallsignIndex::s_version(1u);
+
+namespace {
+const char s_magic[8] = { 'C', 'A', 'B', 'C', 'A', 'L', 'L', '\n' };
+const std::uint32_t s_byteOrder(0x01020304u);
+
+/// The fixed size header at the start of every index file
+struct IndexHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint64_t payloadHash;
+  std::uint64_t payloadLength;
+  std::uint32_t numLogs;
+  std::uint32_t numKeys;
+};
+
+static_assert(sizeof(IndexHeader) == 40u, "IndexHeader must not have padding");
+
+using Posting = CallsignIndex::Posting;
+using PostingList = CallsignIndex::PostingList;
+
+bool
+before(const Posting &a, const Posting &b) noexcept
+{
+  return (a.log < b.log) || ((a.log == b.log) && (a.row < b.row));
+}
+
+void
+appendVarint(std::string &buf, std::uint32_t value)
+{
+  while (value >= 0x80u) {
+    buf.push_back(static_cast<char>((value & 0x7fu) | 0x80u));
+    value >>= 7;
+  }
+  buf.push_back(static_cast<char>(value));
+}
+
+[[noreturn]] void
+badIndex(const std::string &why)
+{
+  throw std::runtime_error("Invalid callsign index: " + why);
+}
+
+std::uint32_t
+readVarint(const unsigned char *&pos, const unsigned char *end)
+{
+  std::uint32_t result(0u);
+  for (unsigned shift = 0u; shift < 32u; shift += 7u) {
+    if (pos >= end) {
+      badIndex("truncated posting list");
+    }
+    const unsigned char byte(*pos++);
+    result |= static_cast<std::uint32_t>(byte & 0x7fu) << shift;
+    if (!(byte & 0x80u)) {
+      return result;
+    }
+  }
+  badIndex("bad varint in posting list");
+}
+
+/// append @p posting, which must follow (@p prevLog, @p prevRow)
+void
+encodePosting(std::string &buf, std::uint32_t &prevLog, std::uint32_t &prevRow,
+              const Posting &posting)
+{
+  const std::uint32_t logDelta(posting.log - prevLog);
+  appendVarint(buf, logDelta);
+  appendVarint(buf, logDelta ? posting.row : (posting.row - prevRow));
+  buf.push_back(static_cast<char>(posting.band));
+  prevLog = posting.log;
+  prevRow = posting.row;
+}
+
+std::string
+encodePostings(const PostingList &postings)
+{
+  std::string result;
+  std::uint32_t log(0u), row(0u);
+  for (const Posting &posting : postings) {
+    encodePosting(result, log, row, posting);
+  }
+  return result;
+}
+
+void
+decodePostings(const char *begin, std::size_t length, PostingList &out)
+{
+  const unsigned char *pos(reinterpret_cast<const unsigned char *>(begin));
+  const unsigned char *const end(pos + length);
+  std::uint32_t log(0u), row(0u);
+  while (pos < end) {
+    const std::uint32_t logDelta(readVarint(pos, end));
+    const std::uint32_t rowValue(readVarint(pos, end));
+    if (pos >= end) {
+      badIndex("truncated posting list");
+    }
+    const unsigned band(*pos++);
+    log += logDelta;
+    row = logDelta ? rowValue : (row + rowValue);
+    out.push_back(Posting{ log, row, (band < e_UnknownBand) ?
+                           static_cast<Band>(band) : e_UnknownBand });
+  }
+}
+
+/// the upper case callsign in @p cell without surrounding spaces
+std::string
+normalizeCall(const std::string &cell)
+{
+  std::size_t begin(cell.find_first_not_of(" \t"));
+  if (std::string::npos == begin) {
+    return std::string();
+  }
+  const std::size_t end(cell.find_last_not_of(" \t") + 1u);
+  std::string result(cell, begin, end - begin);
+  for (char &ch : result) {
+    ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+  }
+  return result;
+}
+
+bool
+startsWith(const char *text, std::size_t length, const std::string &prefix) noexcept
+{
+  return (length >= prefix.size()) && !std::memcmp(text, prefix.data(), prefix.size());
+}
+
+int
+compareKey(const char *text, std::size_t length, const std::string &key) noexcept
+{
+  const int result(std::memcmp(text, key.data(), std::min(length, key.size())));
+  if (result) {
+    return result;
+  }
+  return (length < key.size()) ? -1 : ((length > key.size()) ? 1 : 0);
+}
+
+void
+sortPostings(PostingList &postings)
+{
+  std::sort(postings.begin(), postings.end(), before);
+}
+
+std::vector<std::uint32_t>
+uniqueLogs(const PostingList &postings)
+{
+  std::vector<std::uint32_t> result;
+  for (const Posting &posting : postings) {
+    if (result.empty() || (result.back() != posting.log)) {
+      result.push_back(posting.log);
+    }
+  }
+  return result;
+}
+
+/// call @p func(i) for every i below @p count from up to @p numThreads threads
+template <typename Func>
+void
+parallelFor(std::size_t count, unsigned numThreads, Func func)
+{
+  if (0u == numThreads) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  numThreads = static_cast<unsigned>(std::min<std::size_t>(numThreads, count));
+  std::atomic<std::size_t> next(0u);
+  auto worker = [&]() {
+    for (std::size_t i = next++; i < count; i = next++) {
+      func(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1u; i < numThreads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+void
+append32(std::string &buf, std::uint32_t value)
+{
+  buf.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void
+append64(std::string &buf, std::uint64_t value)
+{
+  buf.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/// sections start on eight byte boundaries
+void
+align8(std::string &buf)
+{
+  buf.resize((buf.size() + 7u) & ~static_cast<std::size_t>(7u), '\0');
+}
+
+std::uint32_t
+checked32(std::size_t value)
+{
+  if (value > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("Callsign index is too large for the file format");
+  }
+  return static_cast<std::uint32_t>(value);
+}
+}
+
+CallsignIndex::CallsignIndex()
+  : CallsignIndex(Options())
+{
+}
+
+CallsignIndex::CallsignIndex(const Options &options)
+  : d_options(options),
+    d_numBaseLogs(0u),
+    d_numKeys(0u),
+    d_keyOffsets(0u),
+    d_postingOffsets(0u),
+    d_keyText(0u),
+    d_postings(0u)
+{
+  if (0u == options.shards) {
+    throw std::invalid_argument("A callsign index needs at least one shard");
+  }
+  d_shards.resize(options.shards);
+}
+
+CallsignIndex::CallsignIndex(const std::string &path, bool verify)
+  : CallsignIndex(path, Options(), verify)
+{
+}
+
+CallsignIndex::CallsignIndex(const std::string &path, const Options &options,
+                             bool verify)
+  : CallsignIndex(options)
+{
+  d_base.reset(new MappedFile(path));
+  IndexHeader hdr;
+  if (d_base->size() < sizeof(hdr)) {
+    badIndex("file is too short");
+  }
+  std::memcpy(&hdr, d_base->data(), sizeof(hdr));
+  if (std::memcmp(hdr.magic, s_magic, sizeof(s_magic))) {
+    badIndex("wrong magic number");
+  }
+  if (s_byteOrder != hdr.byteOrder) {
+    badIndex("wrong byte order");
+  }
+  if (s_version != hdr.version) {
+    badIndex("unsupported version " + std::to_string(hdr.version));
+  }
+  if (hdr.payloadLength != (d_base->size() - sizeof(hdr))) {
+    badIndex("wrong length");
+  }
+  if (verify &&
+      (hdr.payloadHash != hash64(d_base->data() + sizeof(hdr), hdr.payloadLength))) {
+    badIndex("checksum mismatch");
+  }
+  d_numBaseLogs = hdr.numLogs;
+  d_numKeys = hdr.numKeys;
+  const auto aligned = [](std::size_t offset) {
+    return (offset + 7u) & ~static_cast<std::size_t>(7u);
+  };
+  d_keyOffsets = aligned(sizeof(hdr) + 4u*d_numBaseLogs);
+  d_postingOffsets = aligned(d_keyOffsets + 4u*(d_numKeys + 1u));
+  d_keyText = d_postingOffsets + 8u*(d_numKeys + 1u);
+  if (d_keyText > d_base->size()) {
+    badIndex("truncated callsign table");
+  }
+  d_postings = aligned(d_keyText + load32(d_keyOffsets + 4u*d_numKeys));
+  if ((d_postings > d_base->size()) ||
+      ((d_base->size() - d_postings) < load64(d_postingOffsets + 8u*d_numKeys))) {
+    badIndex("truncated posting lists");
+  }
+  // the hash is only checked when asked, but the lookups must stay in
+  // the file even so, and the ends are checked above
+  for (std::size_t i = 0u; i < d_numKeys; ++i) {
+    if ((load32(d_keyOffsets + 4u*i) > load32(d_keyOffsets + 4u*i + 4u)) ||
+        (load64(d_postingOffsets + 8u*i) > load64(d_postingOffsets + 8u*i + 8u))) {
+      badIndex("offsets out of order");
+    }
+  }
+}
+
+CallsignIndex::~CallsignIndex() = default;
+
+std::uint32_t
+CallsignIndex::load32(std::size_t offset) const noexcept
+{
+  std::uint32_t value;
+  std::memcpy(&value, d_base->data() + offset, sizeof(value));
+  return value;
+}
+
+std::uint64_t
+CallsignIndex::load64(std::size_t offset) const noexcept
+{
+  std::uint64_t value;
+  std::memcpy(&value, d_base->data() + offset, sizeof(value));
+  return value;
+}
+
+TableText::FieldSpan
+CallsignIndex::baseKey(std::size_t i) const noexcept
+{
+  const std::uint32_t begin(load32(d_keyOffsets + 4u*i));
+  const std::uint32_t end(load32(d_keyOffsets + 4u*i + 4u));
+  return TableText::FieldSpan{ d_base->data() + d_keyText + begin, end - begin };
+}
+
+TableText::FieldSpan
+CallsignIndex::basePostings(std::size_t i) const noexcept
+{
+  const std::uint64_t begin(load64(d_postingOffsets + 8u*i));
+  const std::uint64_t end(load64(d_postingOffsets + 8u*i + 8u));
+  return TableText::FieldSpan{ d_base->data() + d_postings + begin,
+                               static_cast<std::size_t>(end - begin) };
+}
+
+std::size_t
+CallsignIndex::lowerBound(const std::string &key) const noexcept
+{
+  std::size_t low(0u), high(d_numKeys);
+  while (low < high) {
+    const std::size_t mid(low + (high - low)/2u);
+    const TableText::FieldSpan midKey(baseKey(mid));
+    if (compareKey(midKey.data, midKey.length, key) < 0) {
+      low = mid + 1u;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+std::size_t
+CallsignIndex::shardOf(const std::string &call) const noexcept
+{
+  return hash64(call.data(), call.size()) % d_shards.size();
+}
+
+bool
+CallsignIndex::appendPosting(List &list, const Posting &posting)
+{
+  if (list.bytes.empty() || (posting.log > list.lastLog) ||
+      ((posting.log == list.lastLog) && (posting.row > list.lastRow))) {
+    encodePosting(list.bytes, list.lastLog, list.lastRow, posting);
+    return true;
+  }
+  return false;
+}
+
+void
+CallsignIndex::mergePostings(List &list, const PostingList &postings)
+{
+  PostingList merged;
+  decodePostings(list.bytes.data(), list.bytes.size(), merged);
+  const std::size_t middle(merged.size());
+  merged.insert(merged.end(), postings.begin(), postings.end());
+  std::inplace_merge(merged.begin(), merged.begin() + middle, merged.end(), before);
+  list.bytes.clear();
+  list.lastLog = list.lastRow = 0u;
+  for (const Posting &posting : merged) {
+    encodePosting(list.bytes, list.lastLog, list.lastRow, posting);
+  }
+}
+
+bool
+CallsignIndex::hasLog(std::uint32_t log) const
+{
+  if (std::binary_search(d_logs.begin(), d_logs.end(), log)) {
+    return true;
+  }
+  std::size_t low(0u), high(d_numBaseLogs);
+  while (low < high) {
+    const std::size_t mid(low + (high - low)/2u);
+    const std::uint32_t midLog(load32(sizeof(IndexHeader) + 4u*mid));
+    if (midLog == log) {
+      return true;
+    }
+    if (midLog < log) {
+      low = mid + 1u;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return false;
+}
+
+void
+CallsignIndex::addLog(std::uint32_t log, const TableText::RowAndColumnList &rows)
+{
+  addLogs(std::vector<LogRows> { LogRows{ log, &rows } }, 1u);
+}
+
+void
+CallsignIndex::addLogs(const std::vector<LogRows> &logs, unsigned numThreads)
+{
+  std::vector<std::uint32_t> ids;
+  ids.reserve(logs.size());
+  for (const LogRows &log : logs) {
+    if (hasLog(log.log)) {
+      throw std::invalid_argument("Log " + std::to_string(log.log) +
+                                  " is already in the callsign index");
+    }
+    ids.push_back(log.log);
+  }
+  std::sort(ids.begin(), ids.end());
+  const auto repeated(std::adjacent_find(ids.begin(), ids.end()));
+  if (repeated != ids.end()) {
+    throw std::invalid_argument("Log " + std::to_string(*repeated) +
+                                " is added twice to the callsign index");
+  }
+
+  // first sort the QSO lines of each log into shards
+  struct Entry {
+    std::string call;
+    Posting posting;
+  };
+  const std::size_t minColumns(std::max(d_options.callColumn, d_options.freqColumn) + 1u);
+  std::vector<std::vector<std::vector<Entry>>> buckets(logs.size());
+  parallelFor(logs.size(), numThreads, [&](std::size_t i) {
+    buckets[i].resize(d_shards.size());
+    const TableText::RowAndColumnList &rows(*logs[i].rows);
+    for (std::size_t row = 0u; row < rows.size(); ++row) {
+      if (rows[row].size() < minColumns) {
+        continue;
+      }
+      std::string call(normalizeCall(rows[row][d_options.callColumn]));
+      if (!call.empty()) {
+        const std::size_t shard(shardOf(call));
+        const Band band(bandFromFrequency(rows[row][d_options.freqColumn]));
+        buckets[i][shard].push_back(Entry{ std::move(call),
+                                           Posting{ logs[i].log, static_cast<std::uint32_t>(row), band } });
+      }
+    }
+  });
+
+  // then fill each shard from one thread, taking the logs in order of id
+  std::vector<std::size_t> order(logs.size());
+  for (std::size_t i = 0u; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&logs](std::size_t a, std::size_t b) {
+    return logs[a].log < logs[b].log;
+  });
+  parallelFor(d_shards.size(), numThreads, [&](std::size_t shard) {
+    // the postings of logs with smaller ids than some added before are
+    // merged into each list once, not one at a time
+    std::map<List *, PostingList> late;
+    for (std::size_t i : order) {
+      for (Entry &entry : buckets[i][shard]) {
+        List &list(d_shards[shard][std::move(entry.call)]);
+        if (!appendPosting(list, entry.posting)) {
+          late[&list].push_back(entry.posting);
+        }
+      }
+    }
+    for (const auto &postings : late) {
+      mergePostings(*postings.first, postings.second);
+    }
+  });
+
+  const std::size_t oldSize(d_logs.size());
+  d_logs.insert(d_logs.end(), ids.begin(), ids.end());
+  std::inplace_merge(d_logs.begin(), d_logs.begin() + oldSize, d_logs.end());
+}
+
+template <typename Func>
+void
+CallsignIndex::forEachMatch(const std::string &pattern, Func &&func) const
+{
+  const bool prefix(!pattern.empty() && ('*' == pattern.back()));
+  const std::string key(normalizeCall(prefix ? pattern.substr(0u, pattern.size() - 1u) :
+                                      pattern));
+  if (key.empty() && !prefix) {
+    return;
+  }
+  for (std::size_t i = lowerBound(key); i < d_numKeys; ++i) {
+    const TableText::FieldSpan call(baseKey(i));
+    if (prefix ? !startsWith(call.data, call.length, key) :
+        (0 != compareKey(call.data, call.length, key))) {
+      break;
+    }
+    func(call, basePostings(i));
+  }
+  if (!prefix) {
+    const Shard &shard(d_shards[shardOf(key)]);
+    const auto found(shard.find(key));
+    if (found != shard.end()) {
+      func(TableText::FieldSpan{ found->first.data(), found->first.size() },
+           TableText::FieldSpan{ found->second.bytes.data(), found->second.bytes.size() });
+    }
+    return;
+  }
+  for (const Shard &shard : d_shards) {
+    for (auto it = shard.lower_bound(key);
+         (it != shard.end()) && startsWith(it->first.data(), it->first.size(), key); ++it) {
+      func(TableText::FieldSpan{ it->first.data(), it->first.size() },
+           TableText::FieldSpan{ it->second.bytes.data(), it->second.bytes.size() });
+    }
+  }
+}
+
+std::vector<std::string>
+CallsignIndex::calls(const std::string &pattern) const
+{
+  std::vector<std::string> result;
+  forEachMatch(pattern, [&result](const TableText::FieldSpan &call,
+                                  const TableText::FieldSpan &) {
+    result.push_back(call.str());
+  });
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+CallsignIndex::PostingList
+CallsignIndex::find(const std::string &pattern) const
+{
+  PostingList result;
+  forEachMatch(pattern, [&result](const TableText::FieldSpan &,
+                                  const TableText::FieldSpan &postings) {
+    decodePostings(postings.data, postings.length, result);
+  });
+  sortPostings(result);
+  return result;
+}
+
+CallsignIndex::PostingList
+CallsignIndex::find(const std::string &pattern, Band band) const
+{
+  PostingList result(find(pattern));
+  result.erase(std::remove_if(result.begin(), result.end(), [band](const Posting &posting) {
+    return posting.band != band;
+  }), result.end());
+  return result;
+}
+
+std::vector<std::uint32_t>
+CallsignIndex::findLogs(const std::string &pattern) const
+{
+  return uniqueLogs(find(pattern));
+}
+
+std::vector<std::uint32_t>
+CallsignIndex::findLogs(const std::string &pattern, Band band) const
+{
+  return uniqueLogs(find(pattern, band));
+}
+
+void
+CallsignIndex::save(const std::string &path) const
+{
+  // the callsigns in the shards in sorted order
+  std::vector<Shard::const_iterator> added;
+  for (const Shard &shard : d_shards) {
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      added.push_back(it);
+    }
+  }
+  std::sort(added.begin(), added.end(), [](Shard::const_iterator a, Shard::const_iterator b) {
+    return a->first < b->first;
+  });
+
+  std::string keyText, postings;
+  std::vector<std::uint32_t> keyOffsets(1u, 0u);
+  std::vector<std::uint64_t> postingOffsets(1u, 0u);
+  const auto addKey = [&](const char *call, std::size_t length) {
+    keyText.append(call, length);
+    keyOffsets.push_back(checked32(keyText.size()));
+    postingOffsets.push_back(postings.size());
+  };
+  // merge the callsigns of the file with those in the shards
+  std::size_t base(0u);
+  auto next(added.begin());
+  while ((base < d_numKeys) || (next != added.end())) {
+    const TableText::FieldSpan baseCall(base < d_numKeys ? baseKey(base) :
+                                        TableText::FieldSpan{ nullptr, 0u });
+    const int order((base >= d_numKeys) ? 1 : ((next == added.end()) ? -1 :
+                    compareKey(baseCall.data, baseCall.length, (*next)->first)));
+    if (order < 0) {
+      const TableText::FieldSpan list(basePostings(base++));
+      postings.append(list.data, list.length);
+      addKey(baseCall.data, baseCall.length);
+    }
+    else if (order > 0) {
+      postings.append((*next)->second.bytes);
+      addKey((*next)->first.data(), (*next)->first.size());
+      ++next;
+    }
+    else {
+      PostingList merged;
+      const TableText::FieldSpan list(basePostings(base++));
+      decodePostings(list.data, list.length, merged);
+      decodePostings((*next)->second.bytes.data(), (*next)->second.bytes.size(), merged);
+      sortPostings(merged);
+      postings.append(encodePostings(merged));
+      addKey(baseCall.data, baseCall.length);
+      ++next;
+    }
+  }
+
+  std::vector<std::uint32_t> logs(d_logs);
+  for (std::size_t i = 0u; i < d_numBaseLogs; ++i) {
+    logs.push_back(load32(sizeof(IndexHeader) + 4u*i));
+  }
+  std::inplace_merge(logs.begin(), logs.begin() + d_logs.size(), logs.end());
+
+  std::string buf;
+  buf.reserve(sizeof(IndexHeader) + 4u*logs.size() + 12u*keyOffsets.size() +
+              keyText.size() + postings.size() + 24u);
+  buf.resize(sizeof(IndexHeader), '\0');
+  for (std::uint32_t log : logs) {
+    append32(buf, log);
+  }
+  align8(buf);
+  for (std::uint32_t offset : keyOffsets) {
+    append32(buf, offset);
+  }
+  align8(buf);
+  for (std::uint64_t offset : postingOffsets) {
+    append64(buf, offset);
+  }
+  buf.append(keyText);
+  align8(buf);
+  buf.append(postings);
+
+  IndexHeader hdr;
+  std::memcpy(hdr.magic, s_magic, sizeof(hdr.magic));
+  hdr.version = s_version;
+  hdr.byteOrder = s_byteOrder;
+  hdr.payloadLength = buf.size() - sizeof(IndexHeader);
+  hdr.payloadHash = hash64(buf.data() + sizeof(IndexHeader), hdr.payloadLength);
+  hdr.numLogs = checked32(logs.size());
+  hdr.numKeys = checked32(keyOffsets.size() - 1u);
+  std::memcpy(&buf[0], &hdr, sizeof(hdr));
+  replaceFile(path, buf);
+}
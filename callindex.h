@@ -0,0 +1,221 @@
+/**
+ * @file   callindex.h
+ * @brief  An inverted index from callsigns to the logs that worked them
+ *
+ * Log checkers constantly ask which logs of a contest season contain a
+ * QSO with a given station, perhaps on a given band. Answering that by
+ * tabulating every log again is far too slow, so a CallsignIndex maps
+ * each callsign in the worked-call column of many tabulated logs to a
+ * posting list of (log, row, band) entries.
+ *
+ * Each posting list is sorted by log and row and kept compressed. A
+ * posting is stored as a varint log delta, a varint row (a delta from
+ * the previous row when the log is unchanged) and a band byte, so a
+ * typical posting takes three or four bytes.
+ *
+ * Callsigns are spread over shards by a hash of the callsign. When
+ * many logs are added at once, the QSO lines of each log are sorted
+ * into shards in parallel, then each shard is filled by one thread.
+ *
+ * save() writes every callsign in one sorted table followed by the
+ * posting lists. An index opened from that file maps it into memory
+ * and searches it in place, so lookups take a binary search and no
+ * loading. Logs added afterwards are kept in the shards on top of the
+ * file, and the next save() merges the two.
+ */
+#ifndef __CALLINDEX_H_LOADED__
+#define __CALLINDEX_H_LOADED__
+#include "filemap.h"
+#include "scorer.h"
+#include "tabletext.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cab {
+
+class CallsignIndex {
+public:
+  /// one QSO line that contains a callsign
+  struct Posting {
+    std::uint32_t log;          ///< the log id given when the log was added
+    std::uint32_t row;          ///< the row of the QSO line in the log
+    Band band;
+
+    bool operator==(const Posting &other) const noexcept
+    {
+      return (log == other.log) && (row == other.row) && (band == other.band);
+    }
+  };
+
+  /// postings in order of log and row
+  using PostingList = std::vector<Posting>;
+
+  /// a tabulated log to add to the index
+  struct LogRows {
+    std::uint32_t log;
+    const TableText::RowAndColumnList *rows;
+  };
+
+  struct Options {
+    /// the column holding the callsign worked
+    std::size_t callColumn = 8u;
+    /// the column holding the frequency, which gives the band
+    std::size_t freqColumn = 1u;
+    /// the number of in-memory shards
+    unsigned shards = 64u;
+  };
+
+  /// the version of the file format written by save
+  static const std::uint32_t s_version;
+
+  /// an empty index
+  CallsignIndex();
+
+  /**
+   * @brief an empty index
+   * @exception std::invalid_argument  @p options has no shards
+   */
+  explicit CallsignIndex(const Options &options);
+
+  /**
+   * @brief open an index file written by save
+   * @param verify  when true, the hash of the whole file is checked.
+   *        The offsets of the tables are checked either way, so a
+   *        damaged file can't make a lookup read outside it.
+   * @exception std::system_error   the file could not be opened
+   * @exception std::runtime_error  the file is not a valid index file,
+   *            has the wrong version, or is corrupt
+   */
+  explicit CallsignIndex(const std::string &path, bool verify = true);
+
+  CallsignIndex(const std::string &path, const Options &options,
+                bool verify = true);
+
+  ~CallsignIndex();
+
+  /**
+   * @brief add the QSO lines of one log
+   * @exception std::invalid_argument  the log is already in the index
+   */
+  void addLog(std::uint32_t log, const TableText::RowAndColumnList &rows);
+
+  /**
+   * @brief add many logs using up to @p numThreads threads (zero means
+   *        one per processor). Rows without a callsign are skipped.
+   *
+   * Logs are cheapest to add in order of id. A call that adds logs with
+   * smaller ids than ones already added re-encodes each posting list
+   * they touch once, so adding many such logs one call at a time costs
+   * time in proportion to the square of the list lengths.
+   * @exception std::invalid_argument  a log is already in the index or
+   *            appears twice in @p logs. Nothing is added.
+   */
+  void addLogs(const std::vector<LogRows> &logs, unsigned numThreads = 0u);
+
+  /// return true if the log @p log has been added
+  bool hasLog(std::uint32_t log) const;
+
+  /// the number of logs in the index
+  std::size_t getNumLogs() const noexcept
+  {
+    return d_numBaseLogs + d_logs.size();
+  }
+
+  /**
+   * @brief return the callsigns that match @p pattern in sorted order.
+   *
+   * Case is ignored. A pattern that ends in '*' matches every callsign
+   * that starts with the rest of the pattern (e.g., "DL*"), so "*"
+   * matches every callsign. Any other pattern matches one callsign.
+   */
+  std::vector<std::string> calls(const std::string &pattern) const;
+
+  /// return the QSO lines whose callsign matches @p pattern
+  PostingList find(const std::string &pattern) const;
+
+  /// return the QSO lines on @p band whose callsign matches @p pattern
+  PostingList find(const std::string &pattern, Band band) const;
+
+  /// return the sorted ids of the logs with a QSO that matches @p pattern
+  std::vector<std::uint32_t> findLogs(const std::string &pattern) const;
+
+  /**
+   * @brief return the sorted ids of the logs with a QSO on @p band that
+   *        matches @p pattern
+   */
+  std::vector<std::uint32_t>
+  findLogs(const std::string &pattern, Band band) const;
+
+  /**
+   * @brief write the whole index to @p path. An index opened from the
+   *        file doesn't need the logs again.
+   * @exception std::system_error  the file could not be written
+   * @exception std::length_error  the index is too large for the format
+   */
+  void save(const std::string &path) const;
+private:
+  CallsignIndex(const CallsignIndex &) = delete;
+  CallsignIndex &operator=(const CallsignIndex &) = delete;
+
+  /// the compressed postings of one callsign in a shard
+  struct List {
+    std::string bytes;
+    std::uint32_t lastLog = 0u;
+    std::uint32_t lastRow = 0u;
+  };
+
+  using Shard = std::map<std::string, List>;
+
+  /**
+   * @brief append @p posting to @p list if it follows the last posting
+   * @return false if @p posting belongs earlier in the list
+   */
+  static bool appendPosting(List &list, const Posting &posting);
+
+  /// merge @p postings, which are in order, into @p list
+  static void mergePostings(List &list, const PostingList &postings);
+
+  std::size_t shardOf(const std::string &call) const noexcept;
+
+  /**
+   * @brief call @p func with each callsign that matches @p pattern and
+   *        its encoded postings, first from the file and then from the
+   *        shards
+   */
+  template <typename Func>
+  void forEachMatch(const std::string &pattern, Func &&func) const;
+
+  /// the first callsign in the file that is not less than @p key
+  std::size_t lowerBound(const std::string &key) const noexcept;
+
+  /// the callsign at @p i in the file
+  TableText::FieldSpan baseKey(std::size_t i) const noexcept;
+
+  /// the encoded postings of the callsign at @p i in the file
+  TableText::FieldSpan basePostings(std::size_t i) const noexcept;
+
+  std::uint32_t load32(std::size_t offset) const noexcept;
+
+  std::uint64_t load64(std::size_t offset) const noexcept;
+
+  Options d_options;
+  std::vector<Shard> d_shards;
+  /// the sorted ids of the logs added since the file was opened
+  std::vector<std::uint32_t> d_logs;
+  /// the index file, if one was opened
+  std::unique_ptr<MappedFile> d_base;
+  std::size_t d_numBaseLogs;
+  std::size_t d_numKeys;
+  /// offsets of the sections of the index file
+  std::size_t d_keyOffsets;
+  std::size_t d_postingOffsets;
+  std::size_t d_keyText;
+  std::size_t d_postings;
+};
+}
+
+#endif /*  __CALLINDEX_H_LOADED__ */
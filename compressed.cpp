@@ -0,0 +1,274 @@
+#include "compressed.h"
+#include "tabletext.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+
+using namespace cab;
+
+namespace {
+const std::uint32_t s_localHeaderSignature(0x04034b50u);
+const std::uint32_t s_centralHeaderSignature(0x02014b50u);
+const std::uint32_t s_endOfDirectorySignature(0x06054b50u);
+const std::size_t s_endOfDirectorySize(22u);
+const std::size_t s_chunkSize(1u << 16);
+/// deflate can't expand data by more than this
+const std::size_t s_maxInflateRatio(1032u);
+/// the largest size hint, however well compressed the file
+const std::size_t s_maxSizeHint(std::size_t(1) << 28);
+
+// zip and gzip numbers are little endian
+std::uint32_t
+get16(const char *ptr) noexcept
+{
+  const unsigned char *const bytes(reinterpret_cast<const unsigned char *>(ptr));
+  return static_cast<std::uint32_t>(bytes[0]) | (static_cast<std::uint32_t>(bytes[1]) << 8);
+}
+
+std::uint32_t
+get32(const char *ptr) noexcept
+{
+  return get16(ptr) | (get16(ptr + 2) << 16);
+}
+
+/**
+ * @brief return the size recorded in a file for @p compressed bytes of
+ *        data, limited to what they can hold, so a damaged or hostile
+ *        size can't ask for a huge buffer
+ */
+std::size_t
+boundedSize(std::size_t recorded, std::size_t compressed, bool stored) noexcept
+{
+  const std::size_t most(stored ? compressed :
+                         ((compressed > s_maxSizeHint/s_maxInflateRatio) ? s_maxSizeHint :
+                          (compressed * s_maxInflateRatio)));
+  return std::min(std::min(recorded, most), s_maxSizeHint);
+}
+
+bool
+endsWith(const std::string &str, const char *suffix)
+{
+  const std::size_t len(std::strlen(suffix));
+  if (str.size() < len) {
+    return false;
+  }
+  for (std::size_t i = 0u; i < len; ++i) {
+    if (std::tolower(static_cast<unsigned char>(str[str.size() - len + i])) != suffix[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+Compression
+cab::compressionFromPath(const std::string &path)
+{
+  if (endsWith(path, ".gz")) {
+    return Compression::Gzip;
+  }
+  return endsWith(path, ".zip") ? Compression::Zip : Compression::None;
+}
+
+InflateReader::InflateReader(const std::string &path, Compression compression)
+  : d_path(path),
+    d_file(path),
+    d_compression(compression),
+    d_nextEntry(0u),
+    d_sizeHint(0u),
+    d_stream(new z_stream()),
+    d_inflating(false),
+    d_inflateLeft(0u),
+    d_stored(nullptr),
+    d_storedLeft(0u)
+{
+  if (Compression::Zip == compression) {
+    readDirectory();
+  }
+  else {
+    d_entries.push_back(Entry{ 0u, d_file.size(), 8u });
+    if (d_file.size() >= 4u) {
+      // the gzip trailer ends with the size modulo 2^32
+      d_sizeHint = boundedSize(get32(d_file.data() + d_file.size() - 4u), d_file.size(), false);
+    }
+  }
+}
+
+InflateReader::~InflateReader()
+{
+  if (d_inflating) {
+    inflateEnd(d_stream.get());
+  }
+}
+
+void
+InflateReader::readDirectory()
+{
+  const char *const data(d_file.data());
+  const std::size_t size(d_file.size());
+  if (size < s_endOfDirectorySize) {
+    throw std::runtime_error("Not a zip archive: " + d_path);
+  }
+  // the end of directory record is followed by a comment of up to 64 KiB
+  std::size_t end(size - s_endOfDirectorySize);
+  const std::size_t lowest(end > 0xffffu ? (end - 0xffffu) : 0u);
+  while ((get32(data + end) != s_endOfDirectorySignature) && (end > lowest)) {
+    --end;
+  }
+  if (get32(data + end) != s_endOfDirectorySignature) {
+    throw std::runtime_error("Not a zip archive: " + d_path);
+  }
+  const std::size_t numEntries(get16(data + end + 10u));
+  const std::size_t directorySize(get32(data + end + 12u));
+  std::size_t pos(get32(data + end + 16u));
+  if ((0xffffu == numEntries) || (0xffffffffu == pos) || (pos + directorySize > end)) {
+    throw std::runtime_error("Unsupported or damaged zip archive: " + d_path);
+  }
+  for (std::size_t i = 0u; i < numEntries; ++i) {
+    if ((pos + 46u > end) || (get32(data + pos) != s_centralHeaderSignature)) {
+      throw std::runtime_error("Damaged zip directory: " + d_path);
+    }
+    const unsigned flags(get16(data + pos + 8u));
+    const unsigned method(get16(data + pos + 10u));
+    const std::size_t compressedSize(get32(data + pos + 20u));
+    const std::size_t uncompressedSize(get32(data + pos + 24u));
+    const std::size_t nameLength(get16(data + pos + 28u));
+    const std::size_t extraLength(get16(data + pos + 30u));
+    const std::size_t commentLength(get16(data + pos + 32u));
+    const std::size_t localHeader(get32(data + pos + 42u));
+    if (pos + 46u + nameLength + extraLength + commentLength > end) {
+      throw std::runtime_error("Damaged zip directory: " + d_path);
+    }
+    const bool isDirectory(nameLength && ('/' == data[pos + 46u + nameLength - 1u]));
+    pos += 46u + nameLength + extraLength + commentLength;
+    if (isDirectory) {
+      continue;
+    }
+    if (flags & 1u) {
+      throw std::runtime_error("Encrypted zip archive: " + d_path);
+    }
+    if ((0u != method) && (8u != method)) {
+      throw std::runtime_error("Unsupported zip compression method in " + d_path);
+    }
+    if ((localHeader + 30u > size) || (get32(data + localHeader) != s_localHeaderSignature)) {
+      throw std::runtime_error("Damaged zip entry: " + d_path);
+    }
+    const std::size_t offset(localHeader + 30u + get16(data + localHeader + 26u) +
+                             get16(data + localHeader + 28u));
+    if (offset + compressedSize > size) {
+      throw std::runtime_error("Damaged zip entry: " + d_path);
+    }
+    d_entries.push_back(Entry{ offset, compressedSize, method });
+    d_sizeHint = std::min(d_sizeHint + boundedSize(uncompressedSize, compressedSize, 0u == method),
+                          s_maxSizeHint);
+  }
+}
+
+bool
+InflateReader::startEntry()
+{
+  if (d_nextEntry >= d_entries.size()) {
+    return false;
+  }
+  const Entry &entry(d_entries[d_nextEntry++]);
+  if (0u == entry.method) {
+    d_stored = d_file.data() + entry.offset;
+    d_storedLeft = entry.size;
+    return true;
+  }
+  z_stream &stream(*d_stream);
+  stream = z_stream();
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(d_file.data() + entry.offset));
+  // avail_in is narrower than size_t, so read() hands the input over in slices
+  d_inflateLeft = entry.size;
+  // zip entries are raw deflate data
+  const int windowBits(Compression::Zip == d_compression ? -MAX_WBITS : (MAX_WBITS + 16));
+  if (inflateInit2(&stream, windowBits) != Z_OK) {
+    throw std::runtime_error("Unable to start decompressing " + d_path);
+  }
+  d_inflating = true;
+  return true;
+}
+
+std::size_t
+InflateReader::read(char *buf, std::size_t len)
+{
+  if (0u == len) {
+    return 0u;
+  }
+  for (;;) {
+    if (d_storedLeft) {
+      const std::size_t count(std::min(len, d_storedLeft));
+      std::copy(d_stored, d_stored + count, buf);
+      d_stored += count;
+      d_storedLeft -= count;
+      return count;
+    }
+    if (d_inflating) {
+      z_stream &stream(*d_stream);
+      // the rest of the input follows next_in in the mapped file
+      const std::size_t refill(std::min<std::size_t>(d_inflateLeft, UINT_MAX - stream.avail_in));
+      stream.avail_in += static_cast<uInt>(refill);
+      d_inflateLeft -= refill;
+      stream.next_out = reinterpret_cast<Bytef *>(buf);
+      stream.avail_out = static_cast<uInt>(std::min<std::size_t>(len, 0xffffffffu));
+      const int status(inflate(&stream, Z_NO_FLUSH));
+      const std::size_t produced(reinterpret_cast<char *>(stream.next_out) - buf);
+      if (Z_STREAM_END == status) {
+        if ((Compression::Gzip == d_compression) && ((stream.avail_in + d_inflateLeft) >= 2u) &&
+            (0x1f == stream.next_in[0]) && (0x8b == stream.next_in[1])) {
+          // a gzip file can hold several members one after another
+          inflateReset(&stream);
+        }
+        else {
+          inflateEnd(&stream);
+          d_inflating = false;
+        }
+      }
+      else if ((Z_OK != status) && (Z_BUF_ERROR != status)) {
+        throw std::runtime_error("Corrupt compressed data in " + d_path);
+      }
+      else if ((0u == produced) && (0u == stream.avail_in) && (0u == d_inflateLeft)) {
+        throw std::runtime_error("Truncated compressed data in " + d_path);
+      }
+      if (produced) {
+        return produced;
+      }
+      continue;
+    }
+    if (!startEntry()) {
+      return 0u;
+    }
+  }
+}
+
+std::string
+cab::readLogFile(const std::string &path, std::size_t maxBytes)
+{
+  const Compression compression(compressionFromPath(path));
+  if (Compression::None == compression) {
+    return readFile(path, maxBytes);
+  }
+  InflateReader reader(path, compression);
+  std::string result;
+  result.reserve(maxBytes ? std::min(reader.sizeHint(), maxBytes) : reader.sizeHint());
+  std::size_t size(0u);
+  for (;;) {
+    // inflate straight into the result
+    result.resize(size + s_chunkSize);
+    const std::size_t got(reader.read(&result[size], s_chunkSize));
+    size += got;
+    if (maxBytes && (size > maxBytes)) {
+      throw LimitError(LimitError::Limit::Bytes, size, maxBytes);
+    }
+    if (0u == got) {
+      break;
+    }
+  }
+  result.resize(size);
+  return result;
+}
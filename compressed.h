@@ -0,0 +1,115 @@
+/**
+ * @file   compressed.h
+ * @brief  Read gzip and zip compressed logs without a temporary file
+ *
+ * Archived submissions are stored compressed. These classes inflate a
+ * memory mapped gzip file or zip archive straight into the caller's
+ * buffer, so there is no decompressed copy on disk and no second copy
+ * in memory.
+ */
+#ifndef __COMPRESSED_H_LOADED__
+#define __COMPRESSED_H_LOADED__
+#include "filemap.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct z_stream_s;
+
+namespace cab {
+
+/// The compressed formats that can be read
+enum class Compression {
+  None,
+  Gzip,
+  Zip
+};
+
+/**
+ * @brief return the compression implied by the extension of @p path
+ *        (.gz or .zip, in any case)
+ */
+Compression compressionFromPath(const std::string &path);
+
+/**
+ * @brief Decompresses a gzip file or the files of a zip archive a piece
+ *        at a time. The files of a zip archive are read one after another
+ *        in the order of its central directory, skipping directories.
+ */
+class InflateReader {
+public:
+  /**
+   * @brief open the compressed file @p path
+   * @exception std::system_error   the file could not be mapped
+   * @exception std::runtime_error  the file isn't a zip archive this can
+   *            read (e.g., it uses ZIP64 or encryption)
+   */
+  InflateReader(const std::string &path, Compression compression);
+
+  ~InflateReader();
+
+  /**
+   * @brief decompress up to @p len bytes into @p buf
+   * @return the number of bytes stored, which is zero only at the end
+   * @exception std::runtime_error  the compressed data is corrupt
+   */
+  std::size_t read(char *buf, std::size_t len);
+
+  /**
+   * @brief return the decompressed size recorded in the file. It is only
+   *        a hint, since a gzip file records its size modulo 2^32. It
+   *        is never more than the compressed data could hold or 256 MiB,
+   *        so a damaged size can't ask for a huge buffer.
+   */
+  std::size_t sizeHint() const noexcept
+  {
+    return d_sizeHint;
+  }
+private:
+  InflateReader(const InflateReader &) = delete;
+  InflateReader &operator=(const InflateReader &) = delete;
+
+  /// A compressed file (a gzip file has one)
+  struct Entry {
+    std::size_t offset;         ///< where the compressed data starts
+    std::size_t size;           ///< the number of compressed bytes
+    unsigned method;            ///< 0 for stored or 8 for deflate
+  };
+
+  void readDirectory();
+
+  /// prepare to read d_entries[d_nextEntry]. Returns false at the end.
+  bool startEntry();
+
+  std::string d_path;
+  MappedFile d_file;
+  Compression d_compression;
+  std::vector<Entry> d_entries;
+  std::size_t d_nextEntry;
+  std::size_t d_sizeHint;
+  std::unique_ptr<z_stream_s> d_stream;
+  /// true while d_stream holds an entry being inflated
+  bool d_inflating;
+  /// the compressed input of the entry not yet given to d_stream
+  std::size_t d_inflateLeft;
+  /// the rest of a stored entry
+  const char *d_stored;
+  std::size_t d_storedLeft;
+};
+
+/**
+ * @brief read the whole file @p path, decompressing it if its name ends
+ *        in .gz or .zip
+ * @param maxBytes  if not zero, the largest size accepted after
+ *                  decompression, which stops a small archive from
+ *                  expanding without bound
+ * @exception std::system_error   the file could not be read
+ * @exception std::runtime_error  the compressed data is corrupt
+ * @exception LimitError          the contents are larger than @p maxBytes
+ */
+std::string
+readLogFile(const std::string &path, std::size_t maxBytes = 0u);
+}
+
+#endif /* __COMPRESSED_H_LOADED__ */
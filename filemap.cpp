@@ -0,0 +1,189 @@
+#include "filemap.h"
+#include "tabletext.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cab;
+
+namespace {
+[[noreturn]] void
+throwErrno(const std::string &what)
+{
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+inline std::uint64_t
+mix(std::uint64_t h) noexcept
+{
+  // the finalizer from MurmurHash3
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+}
+
+MappedFile::MappedFile(const std::string &path)
+  : d_data(nullptr),
+    d_size(0u)
+{
+  const int fd(::open(path.c_str(), O_RDONLY));
+  if (fd < 0) {
+    throwErrno("Unable to open " + path);
+  }
+  struct stat info;
+  if (::fstat(fd, &info) < 0) {
+    const int err(errno);
+    ::close(fd);
+    throw std::system_error(err, std::generic_category(), "Unable to stat " + path);
+  }
+  d_size = static_cast<std::size_t>(info.st_size);
+  if (d_size > 0u) {
+    void *addr(::mmap(nullptr, d_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    if (MAP_FAILED == addr) {
+      const int err(errno);
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "Unable to map " + path);
+    }
+    d_data = static_cast<const char *>(addr);
+  }
+  ::close(fd);
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+  : d_data(other.d_data),
+    d_size(other.d_size)
+{
+  other.d_data = nullptr;
+  other.d_size = 0u;
+}
+
+MappedFile &
+MappedFile::operator=(MappedFile &&other) noexcept
+{
+  if (this != &other) {
+    if (d_data) {
+      ::munmap(const_cast<char *>(d_data), d_size);
+    }
+    d_data = other.d_data;
+    d_size = other.d_size;
+    other.d_data = nullptr;
+    other.d_size = 0u;
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile()
+{
+  if (d_data) {
+    ::munmap(const_cast<char *>(d_data), d_size);
+  }
+}
+
+std::uint64_t
+cab::hash64(const void *data, std::size_t len, std::uint64_t seed) noexcept
+{
+  static const std::uint64_t multiplier(0x9e3779b97f4a7c15ull);
+  const unsigned char *bytes(static_cast<const unsigned char *>(data));
+  std::uint64_t h(seed ^ (len * multiplier));
+  while (len >= 8u) {
+    std::uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    h = (h ^ mix(word)) * multiplier;
+    bytes += 8u;
+    len -= 8u;
+  }
+  if (len > 0u) {
+    std::uint64_t word(0u);
+    std::memcpy(&word, bytes, len);
+    h = (h ^ mix(word)) * multiplier;
+  }
+  return mix(h);
+}
+
+std::string
+cab::readFile(const std::string &path, std::size_t maxBytes)
+{
+  const int fd(::open(path.c_str(), O_RDONLY));
+  if (fd < 0) {
+    throwErrno("Unable to open " + path);
+  }
+  std::string result;
+  struct stat info;
+  if ((::fstat(fd, &info) == 0) && (info.st_size > 0)) {
+    const std::size_t size(static_cast<std::size_t>(info.st_size));
+    if (maxBytes && (size > maxBytes)) {
+      ::close(fd);
+      throw LimitError(LimitError::Limit::Bytes, size, maxBytes);
+    }
+    result.reserve(size);
+  }
+  char buffer[65536];
+  for (;;) {
+    const ssize_t got(::read(fd, buffer, sizeof(buffer)));
+    if (got < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      const int err(errno);
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "Unable to read " + path);
+    }
+    if (0 == got) {
+      break;
+    }
+    result.append(buffer, static_cast<std::size_t>(got));
+    // pipes and devices have no size to check in advance
+    if (maxBytes && (result.size() > maxBytes)) {
+      ::close(fd);
+      throw LimitError(LimitError::Limit::Bytes, result.size(), maxBytes);
+    }
+  }
+  ::close(fd);
+  return result;
+}
+
+void
+cab::replaceFile(const std::string &path, const std::string &contents)
+{
+  const std::string tmpPath(path + ".tmp." + std::to_string(::getpid()));
+  const int fd(::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+  if (fd < 0) {
+    throwErrno("Unable to create " + tmpPath);
+  }
+  const char *cur(contents.data());
+  std::size_t remaining(contents.size());
+  while (remaining > 0u) {
+    const ssize_t written(::write(fd, cur, remaining));
+    if (written < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      const int err(errno);
+      ::close(fd);
+      ::unlink(tmpPath.c_str());
+      throw std::system_error(err, std::generic_category(), "Unable to write " + tmpPath);
+    }
+    cur += written;
+    remaining -= static_cast<std::size_t>(written);
+  }
+  if (::close(fd) < 0) {
+    const int err(errno);
+    ::unlink(tmpPath.c_str());
+    throw std::system_error(err, std::generic_category(), "Unable to write " + tmpPath);
+  }
+  if (::rename(tmpPath.c_str(), path.c_str()) < 0) {
+    const int err(errno);
+    ::unlink(tmpPath.c_str());
+    throw std::system_error(err, std::generic_category(), "Unable to rename " + tmpPath);
+  }
+}
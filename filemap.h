@@ -0,0 +1,79 @@
+/**
+ * @file   filemap.h
+ * @brief  Helpers for reading and writing files
+ */
+#ifndef __FILEMAP_H_LOADED__
+#define __FILEMAP_H_LOADED__
+#include <cstdint>
+#include <string>
+
+namespace cab {
+
+/**
+ * @brief A read-only memory mapping of a whole file. The mapping
+ *        is released when the object is destroyed.
+ */
+class MappedFile {
+public:
+  /**
+   * @brief map the file named @p path into memory
+   * @exception std::system_error  the file could not be opened or mapped
+   */
+  explicit MappedFile(const std::string &path);
+
+  MappedFile(MappedFile &&other) noexcept;
+
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  ~MappedFile();
+
+  /// the first byte of the file (nullptr for an empty file)
+  const char *data() const noexcept
+  {
+    return d_data;
+  }
+
+  /// the number of bytes in the file
+  std::size_t size() const noexcept
+  {
+    return d_size;
+  }
+private:
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *d_data;
+  std::size_t d_size;
+};
+
+/**
+ * @brief compute a 64-bit hash of @p len bytes starting at @p data.
+ *
+ * The hash consumes eight bytes at a time, so it is cheap enough
+ * to validate large files when they are opened. It is not a
+ * cryptographic hash.
+ */
+std::uint64_t
+hash64(const void *data, std::size_t len, std::uint64_t seed = 0u) noexcept;
+
+/**
+ * @brief read the whole file @p path
+ * @param maxBytes  if not zero, the largest file accepted. Reading
+ *                  stops as soon as the file is known to be larger.
+ * @exception std::system_error  the file could not be read
+ * @exception LimitError         the file is larger than @p maxBytes
+ */
+std::string
+readFile(const std::string &path, std::size_t maxBytes = 0u);
+
+/**
+ * @brief replace the file @p path with @p contents. The data is written
+ *        to a temporary file that is renamed over @p path, so readers
+ *        never see a partially written file.
+ * @exception std::system_error  the file could not be written
+ */
+void
+replaceFile(const std::string &path, const std::string &contents);
+}
+
+#endif /*  __FILEMAP_H_LOADED__ */
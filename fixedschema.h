@@ -0,0 +1,291 @@
+/**
+ * @file   fixedschema.h
+ * @brief  A fast path for logs that follow a known column template
+ *
+ * Most logs from a given contest are produced by software that
+ * follows the contest's published column template exactly. For
+ * those logs, the statistical column detection in TableText isn't
+ * needed. A FixedSchema describes the expected columns at compile
+ * time. One pass over the text verifies that every line fits the
+ * template, and the fields are sliced with the column loop unrolled.
+ * If any line doesn't fit, or if the text has tabs or non-ASCII
+ * characters, the text is tabulated the usual way.
+ *
+ * For example, the QSO lines of a contest with a sent and received
+ * exchange could be described as
+ * @code
+ * using QSOSchema = cab::FixedSchema<
+ *   cab::SchemaColumn< 0,  4>,
+ *   cab::SchemaColumn< 5, 10, cab::Justify::Right, cab::ValueKind::Digits>,
+ *   ...
+ *   cab::SchemaColumn<70, cab::s_toEndOfLine>>;
+ * auto rows = QSOSchema::extract(table);
+ * @endcode
+ */
+#ifndef __FIXEDSCHEMA_H_LOADED__
+#define __FIXEDSCHEMA_H_LOADED__
+#include "tabletext.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace cab {
+
+/// How the values in a column are aligned
+enum class Justify {
+  Left,                         ///< values start at the first position
+  Right                         ///< values end at the last position
+};
+
+/// The characters allowed in the values of a column
+enum class ValueKind {
+  Any,                          ///< no restriction
+  Digits,                       ///< 0-9 (e.g., frequency, serial number, time)
+  Letters,                      ///< A-Z and a-z (e.g., mode)
+  Callsign,                     ///< letters, digits, and '/'
+  Date                          ///< digits and '-' (e.g., 2014-10-04)
+};
+
+/// A column end that means the column runs to the end of the line
+static constexpr std::size_t s_toEndOfLine = static_cast<std::size_t>(-1);
+
+/**
+ * @brief One column of a FixedSchema
+ * @tparam Begin  the first character position of the column
+ * @tparam End    one past the last character position of the column,
+ *                or s_toEndOfLine
+ */
+template <std::size_t Begin, std::size_t End,
+          Justify J = Justify::Left, ValueKind K = ValueKind::Any>
+struct SchemaColumn {
+  static_assert(Begin < End, "A column must have at least one character");
+  static constexpr std::size_t begin = Begin;
+  static constexpr std::size_t end = End;
+  static constexpr Justify justify = J;
+  static constexpr ValueKind kind = K;
+};
+
+namespace detail {
+constexpr bool
+isDigit(unsigned char ch)
+{
+  return (ch >= '0') && (ch <= '9');
+}
+
+constexpr bool
+isLetter(unsigned char ch)
+{
+  return ((ch >= 'A') && (ch <= 'Z')) || ((ch >= 'a') && (ch <= 'z'));
+}
+
+/// the same characters that cab::trim removes
+constexpr bool
+isTrimSpace(char ch)
+{
+  return (' ' == ch) || (('\t' <= ch) && (ch <= '\r'));
+}
+
+/// return true if @p ch is allowed in a value of kind @p kind
+constexpr bool
+kindAccepts(ValueKind kind, unsigned char ch)
+{
+  return (ValueKind::Digits == kind) ? isDigit(ch) :
+         ((ValueKind::Letters == kind) ? isLetter(ch) :
+          ((ValueKind::Callsign == kind) ? (isDigit(ch) || isLetter(ch) || ('/' == ch)) :
+           ((ValueKind::Date == kind) ? (isDigit(ch) || ('-' == ch)) : true)));
+}
+
+/// return true if the columns are in order and don't overlap
+constexpr bool
+columnsInOrder(const std::size_t *begins, const std::size_t *ends, std::size_t n)
+{
+  for (std::size_t i = 1u; i < n; ++i) {
+    if (ends[i-1] > begins[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+/**
+ * @brief A compile-time description of the columns of a table
+ * @tparam Columns  a list of SchemaColumn types from left to right
+ */
+template <typename... Columns>
+class FixedSchema {
+public:
+  static constexpr std::size_t s_numColumns = sizeof...(Columns);
+  static_assert(s_numColumns > 0u, "A schema needs at least one column");
+
+  /**
+   * @brief return the layout described by the schema with the
+   *        last column clipped to @p maxWidth
+   */
+  static TableText::ColumnLayout
+  layout(std::size_t maxWidth)
+  {
+    TableText::ColumnLayout result;
+    result.reserve(s_numColumns);
+    for (std::size_t i = 0u; i < s_numColumns; ++i) {
+      result.push_back(TableText::ColumnRange{ s_begins[i], std::min(s_ends[i], maxWidth) });
+    }
+    return result;
+  }
+
+  /**
+   * @brief return true if every line of @p text fits the schema.
+   *
+   * A line fits when the characters between columns are spaces, every
+   * non-space character of a column is allowed by its ValueKind, and
+   * the values are justified as described.
+   */
+  static bool
+  verify(const std::string &text)
+  {
+    const char *cur(text.data());
+    const char *const end(cur + text.size());
+    while (cur < end) {
+      const char *const next(static_cast<const char *>(std::memchr(cur, '\n', end - cur)));
+      const char *const lineEnd(next ? next : end);
+      if (!verifyLine(cur, static_cast<std::size_t>(lineEnd - cur))) {
+        return false;
+      }
+      cur = (next ? (next + 1) : end);
+    }
+    return true;
+  }
+
+  /**
+   * @brief slice every line of @p text using the schema without
+   *        verifying it. Fields are trimmed as in TableText::tabulate.
+   */
+  static TableText::RowAndColumnList
+  slice(const std::string &text)
+  {
+    TableText::RowAndColumnList result;
+    const char *cur(text.data());
+    const char *const end(cur + text.size());
+    while (cur < end) {
+      const char *const next(static_cast<const char *>(std::memchr(cur, '\n', end - cur)));
+      const char *const lineEnd(next ? next : end);
+      result.emplace_back();
+      result.back().reserve(s_numColumns);
+      sliceLine(cur, static_cast<std::size_t>(lineEnd - cur), result.back());
+      cur = (next ? (next + 1) : end);
+    }
+    return result;
+  }
+
+  /**
+   * @brief tabulate @p table with the schema if the text fits it.
+   *        Otherwise, fall back to @c table.tabulate(s_numColumns).
+   * @param[out] usedSchema  if not null, set to true when the schema fit
+   * @exception std::out_of_range  the text didn't fit the schema, and
+   *            the fall back couldn't find enough columns
+   */
+  static TableText::RowAndColumnList
+  extract(const TableText &table, bool *usedSchema = nullptr)
+  {
+    // character positions are only columns when the text is plain
+    const bool fits(table.isPlainText() && verify(table.getText()));
+    if (usedSchema) {
+      *usedSchema = fits;
+    }
+    return fits ? slice(table.getText()) :
+           table.tabulate(static_cast<unsigned>(s_numColumns));
+  }
+private:
+  static constexpr std::size_t s_begins[s_numColumns] = { Columns::begin... };
+  static constexpr std::size_t s_ends[s_numColumns] = { Columns::end... };
+  static_assert(detail::columnsInOrder(s_begins, s_ends, s_numColumns),
+                "Schema columns must be in order and must not overlap");
+
+  static bool
+  verifyLine(const char *line, std::size_t len)
+  {
+    // the gaps between columns must be blank
+    for (std::size_t i = 1u; i < s_numColumns; ++i) {
+      const std::size_t gapEnd(std::min(s_begins[i], len));
+      for (std::size_t pos = s_ends[i-1]; pos < gapEnd; ++pos) {
+        if (' ' != line[pos]) {
+          return false;
+        }
+      }
+    }
+    // nothing may follow the last column
+    if ((s_ends[s_numColumns-1] < len) &&
+        (line + len) != std::find_if(line + s_ends[s_numColumns-1], line + len,
+                                     [](char ch) {
+                                       return ' ' != ch;
+                                     })) {
+      return false;
+    }
+    bool fits(true);
+    const int unrolled[] = { (fits = fits && verifyColumn<Columns>(line, len), 0)... };
+    static_cast<void>(unrolled);
+    return fits;
+  }
+
+  template <typename Column>
+  static bool
+  verifyColumn(const char *line, std::size_t len)
+  {
+    if (Column::begin >= len) {
+      return true;              // an empty trailing field
+    }
+    const char *const first(line + Column::begin);
+    const char *const last(line + std::min(Column::end, len));
+    bool blank(true);
+    for (const char *cur = first; cur < last; ++cur) {
+      if (' ' != *cur) {
+        blank = false;
+        if (!detail::kindAccepts(Column::kind, static_cast<unsigned char>(*cur))) {
+          return false;
+        }
+      }
+    }
+    if (blank) {
+      return true;
+    }
+    return (Justify::Left == Column::justify) ? (' ' != *first) :
+           ((Column::end <= len) && (' ' != *(last - 1)));
+  }
+
+  static void
+  sliceLine(const char *line, std::size_t len, std::vector<std::string> &row)
+  {
+    const int unrolled[] = { (sliceColumn<Columns>(line, len, row), 0)... };
+    static_cast<void>(unrolled);
+  }
+
+  template <typename Column>
+  static void
+  sliceColumn(const char *line, std::size_t len, std::vector<std::string> &row)
+  {
+    if (Column::begin < len) {
+      const char *first(line + Column::begin);
+      const char *last(line + std::min(Column::end, len));
+      while ((first < last) && detail::isTrimSpace(*first)) {
+        ++first;
+      }
+      while ((first < last) && detail::isTrimSpace(*(last - 1))) {
+        --last;
+      }
+      row.emplace_back(first, last);
+    }
+    else {
+      row.emplace_back();
+    }
+  }
+};
+
+template <typename... Columns>
+constexpr std::size_t FixedSchema<Columns...>::s_begins[];
+
+template <typename... Columns>
+constexpr std::size_t FixedSchema<Columns...>::s_ends[];
+}
+
+#endif /*  __FIXEDSCHEMA_H_LOADED__ */
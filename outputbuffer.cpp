@@ -0,0 +1,74 @@
+#include "outputbuffer.h"
+
+#include <cerrno>
+#include <system_error>
+#include <unistd.h>
+
+using namespace cab;
+
+OutputBuffer::OutputBuffer(int fd, std::size_t capacity)
+  : d_fd(fd),
+    d_buffer(capacity ? capacity : 1u),
+    d_used(0u),
+    d_flushed(0u)
+{
+}
+
+OutputBuffer::~OutputBuffer()
+{
+  try {
+    flush();
+  }
+  catch (...) {
+  }
+}
+
+void
+OutputBuffer::setDescriptor(int fd)
+{
+  flush();
+  d_fd = fd;
+}
+
+void
+OutputBuffer::flush()
+{
+  if (d_used) {
+    // reset first so a failed write doesn't repeat the same data
+    const std::size_t used(d_used);
+    d_flushed += used;
+    d_used = 0u;
+    writeAll(d_buffer.data(), used);
+  }
+}
+
+void
+OutputBuffer::appendLarge(const char *data, std::size_t len)
+{
+  flush();
+  if (len < d_buffer.size()) {
+    std::memcpy(d_buffer.data(), data, len);
+    d_used = len;
+  }
+  else {
+    // too big to be worth copying
+    d_flushed += len;
+    writeAll(data, len);
+  }
+}
+
+void
+OutputBuffer::writeAll(const char *data, std::size_t len)
+{
+  while (len > 0u) {
+    const ssize_t written(::write(d_fd, data, len));
+    if (written < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "Unable to write output");
+    }
+    data += written;
+    len -= static_cast<std::size_t>(written);
+  }
+}
@@ -0,0 +1,90 @@
+/**
+ * @file   outputbuffer.h
+ * @brief  A large reusable output buffer that writes to a file descriptor
+ */
+#ifndef __OUTPUTBUFFER_H_LOADED__
+#define __OUTPUTBUFFER_H_LOADED__
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace cab {
+
+/**
+ * @brief Collect output in a large buffer and hand it to the operating
+ *        system with one write(2) call per buffer full.
+ *
+ * This avoids the per-character overhead of iostreams. The buffer is
+ * allocated once, so the same object can be reused for many files by
+ * calling setDescriptor().
+ */
+class OutputBuffer {
+public:
+  /// the buffer size used when none is given
+  static const std::size_t s_defaultCapacity = 1u << 20;
+
+  /**
+   * @brief write to the file descriptor @p fd. The descriptor is not
+   *        closed by this object.
+   */
+  explicit OutputBuffer(int fd, std::size_t capacity = s_defaultCapacity);
+
+  /// flush any buffered output ignoring errors. Call flush() to see errors.
+  ~OutputBuffer();
+
+  /**
+   * @brief flush the buffer and direct future output to @p fd
+   */
+  void setDescriptor(int fd);
+
+  void append(const char *data, std::size_t len)
+  {
+    if (len <= (d_buffer.size() - d_used)) {
+      std::memcpy(d_buffer.data() + d_used, data, len);
+      d_used += len;
+    }
+    else {
+      appendLarge(data, len);
+    }
+  }
+
+  void append(const std::string &str)
+  {
+    append(str.data(), str.size());
+  }
+
+  void put(char ch)
+  {
+    if (d_used == d_buffer.size()) {
+      flush();
+    }
+    d_buffer[d_used++] = ch;
+  }
+
+  /**
+   * @brief write everything in the buffer to the file descriptor
+   * @exception std::system_error  the write failed
+   */
+  void flush();
+
+  /// the total number of bytes accepted by this object
+  std::size_t getBytesWritten() const noexcept
+  {
+    return d_flushed + d_used;
+  }
+private:
+  OutputBuffer(const OutputBuffer &) = delete;
+  OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+  void appendLarge(const char *data, std::size_t len);
+
+  void writeAll(const char *data, std::size_t len);
+
+  int d_fd;
+  std::vector<char> d_buffer;
+  std::size_t d_used;
+  std::size_t d_flushed;
+};
+}
+
+#endif /*  __OUTPUTBUFFER_H_LOADED__ */
@@ -0,0 +1,153 @@
+#include "pipeline.h"
+#include "boundedqueue.h"
+#include "compressed.h"
+
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <thread>
+
+using namespace cab;
+
+namespace {
+using JobPointer = std::unique_ptr<LogJob>;
+using JobQueue = BoundedQueue<JobPointer>;
+using Clock = std::chrono::steady_clock;
+
+std::uint64_t
+nanosecondsSince(Clock::time_point &start)
+{
+  const Clock::time_point now(Clock::now());
+  const std::uint64_t result(std::chrono::duration_cast<std::chrono::nanoseconds>
+                             (now - start).count());
+  start = now;
+  return result;
+}
+
+/**
+ * @brief move logs from @p in to @p out applying @p work to each one.
+ *        A null pointer marks the end of the input, and it's passed on.
+ */
+template <typename Work>
+void
+runStage(JobQueue &in, JobQueue *out, StageStats &stats, Work work)
+{
+  Clock::time_point start(Clock::now());
+  for (;;) {
+    JobPointer job;
+    in.pop(job);
+    stats.waitNanoseconds += nanosecondsSince(start);
+    if (!job) {
+      break;
+    }
+    work(*job);
+    ++stats.items;
+    stats.busyNanoseconds += nanosecondsSince(start);
+    if (out) {
+      out->push(std::move(job));
+      stats.waitNanoseconds += nanosecondsSince(start);
+    }
+  }
+  if (out) {
+    out->push(JobPointer());
+  }
+}
+}
+
+Pipeline::Pipeline(Consumer consumer)
+  : Pipeline(std::move(consumer), Options())
+{
+}
+
+Pipeline::Pipeline(Consumer consumer, const Options &options)
+  : d_consumer(std::move(consumer)),
+    d_options(options),
+    d_stats(e_NumStages)
+{
+}
+
+void
+Pipeline::run(const std::vector<std::string> &paths)
+{
+  static const char *const stageNames[e_NumStages] = {
+    "read", "normalize", "tabulate", "consume"
+  };
+  for (unsigned stage = 0u; stage < e_NumStages; ++stage) {
+    d_stats[stage] = StageStats{ stageNames[stage], 0u, 0u, 0u };
+  }
+  JobQueue toNormalize(d_options.queueCapacity);
+  JobQueue toTabulate(d_options.queueCapacity);
+  JobQueue toConsume(d_options.queueCapacity);
+  std::exception_ptr consumerError;
+  const unsigned minCols(d_options.minCols);
+
+  std::thread normalizer([&]() {
+    runStage(toNormalize, &toTabulate, d_stats[e_Normalize], [](LogJob &job) {
+      if (job.error.empty()) {
+        try {
+          job.text = normalizeLog(job.source);
+          job.header = headerTags(job.text);
+          job.qsoText = qsoLines(job.text);
+        }
+        catch (const std::exception &e) {
+          job.error = e.what();
+        }
+      }
+    });
+  });
+  std::thread tabulator([&]() {
+    // one TableText is reused for every log
+    TableText table(std::string{}, d_options.table);
+    runStage(toTabulate, &toConsume, d_stats[e_Tabulate], [minCols, &table](LogJob &job) {
+      if (job.error.empty()) {
+        try {
+          table.reset(job.qsoText);
+          job.layout = table.findLayout(minCols);
+          table.tabulate(job.layout, job.rows);
+        }
+        catch (const std::exception &e) {
+          job.error = e.what();
+        }
+      }
+    });
+  });
+  std::thread consumer([&]() {
+    runStage(toConsume, nullptr, d_stats[e_Consume], [&](LogJob &job) {
+      if (!consumerError) {
+        try {
+          d_consumer(job);
+        }
+        catch (...) {
+          consumerError = std::current_exception();
+        }
+      }
+    });
+  });
+
+  // this thread is the reader
+  StageStats &stats(d_stats[e_Read]);
+  Clock::time_point start(Clock::now());
+  for (std::size_t i = 0u; i < paths.size(); ++i) {
+    JobPointer job(new LogJob());
+    job->index = i;
+    job->name = paths[i];
+    try {
+      job->source = readLogFile(paths[i], d_options.table.maxBytes);
+    }
+    catch (const std::exception &e) {
+      job->error = e.what();
+    }
+    ++stats.items;
+    stats.busyNanoseconds += nanosecondsSince(start);
+    toNormalize.push(std::move(job));
+    stats.waitNanoseconds += nanosecondsSince(start);
+  }
+  toNormalize.push(JobPointer());
+
+  normalizer.join();
+  tabulator.join();
+  consumer.join();
+  if (consumerError) {
+    std::rethrow_exception(consumerError);
+  }
+}
@@ -0,0 +1,123 @@
+/**
+ * @file   pipeline.h
+ * @brief  Process many logs at once with a thread per processing stage
+ *
+ * Processing a log has four stages: read the file, normalize the text
+ * (see normalizeLog), find the columns and tabulate the QSO lines, and
+ * hand the result to the caller. Running them one after another leaves
+ * the processor idle while waiting on the disk. The Pipeline runs each
+ * stage on its own thread connected by bounded queues, so while one log
+ * is being tabulated, the next is being normalized and the one after
+ * that is being read. When a stage falls behind, the queue in front of
+ * it fills and the stages before it wait.
+ */
+#ifndef __PIPELINE_H_LOADED__
+#define __PIPELINE_H_LOADED__
+#include "stringreg.h"
+#include "tabletext.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace cab {
+
+/**
+ * @brief A log as it moves through the Pipeline
+ */
+struct LogJob {
+  /// the position of the log in the list of inputs
+  std::size_t index;
+  /// the name of the file
+  std::string name;
+  /// the text as read, after decompression for .gz and .zip files
+  std::string source;
+  /// the normalized text
+  std::string text;
+  /// the header tags
+  HeaderList header;
+  /// the QSO lines of the normalized text
+  std::string qsoText;
+  /// the column layout of the QSO lines
+  TableText::ColumnLayout layout;
+  /// the tabulated QSO lines
+  TableText::RowAndColumnList rows;
+  /// if not empty, the reason processing failed. Later stages skip the log.
+  std::string error;
+};
+
+/**
+ * @brief Time spent by one Pipeline stage
+ */
+struct StageStats {
+  const char *name;
+  /// the number of logs processed
+  std::size_t items;
+  /// time spent doing work
+  std::uint64_t busyNanoseconds;
+  /// time spent waiting for input or for room in the next queue
+  std::uint64_t waitNanoseconds;
+
+  /// the fraction of the time the stage was working
+  double utilization() const noexcept
+  {
+    const std::uint64_t total(busyNanoseconds + waitNanoseconds);
+    return total ? (static_cast<double>(busyNanoseconds) / total) : 0.0;
+  }
+};
+
+class Pipeline {
+public:
+  /// called on the consumer thread once for each log in input order
+  using Consumer = std::function<void(LogJob &)>;
+
+  struct Options {
+    /// the capacity of each queue between stages
+    std::size_t queueCapacity = 8u;
+    /// passed to TableText::tabulate
+    unsigned minCols = 0u;
+    /**
+     * how the QSO lines are tabulated. Logs that exceed its limits
+     * are reported in LogJob::error, and maxBytes also applies to
+     * reading each file.
+     */
+    TableText::Options table;
+  };
+
+  enum Stage {
+    e_Read,
+    e_Normalize,
+    e_Tabulate,
+    e_Consume,
+    e_NumStages
+  };
+
+  explicit Pipeline(Consumer consumer);
+
+  Pipeline(Consumer consumer, const Options &options);
+
+  /**
+   * @brief process the files @p paths and wait until they're done
+   *
+   * Problems with an individual log are reported in LogJob::error.
+   * @exception  any exception thrown by the consumer is rethrown
+   *             after the pipeline has drained.
+   */
+  void run(const std::vector<std::string> &paths);
+
+  /// the statistics for each stage from the last run, indexed by Stage
+  const std::vector<StageStats> &getStats() const noexcept
+  {
+    return d_stats;
+  }
+private:
+  Pipeline() = delete;
+
+  Consumer d_consumer;
+  Options d_options;
+  std::vector<StageStats> d_stats;
+};
+}
+
+#endif /*  __PIPELINE_H_LOADED__ */
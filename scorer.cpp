@@ -0,0 +1,355 @@
+#include "scorer.h"
+#include "stringreg.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cctype>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace cab;
+
+namespace {
+struct BandRange {
+  const char *name;
+  unsigned long lowKHz;
+  unsigned long highKHz;
+};
+
+const BandRange s_bands[e_NumBands] = {
+  { "160m", 1800ul, 2000ul },
+  { "80m", 3500ul, 4000ul },
+  { "60m", 5330ul, 5410ul },
+  { "40m", 7000ul, 7300ul },
+  { "30m", 10100ul, 10150ul },
+  { "20m", 14000ul, 14350ul },
+  { "17m", 18068ul, 18168ul },
+  { "15m", 21000ul, 21450ul },
+  { "12m", 24890ul, 24990ul },
+  { "10m", 28000ul, 29700ul },
+  { "6m", 50000ul, 54000ul },
+  { "2m", 144000ul, 148000ul },
+  { "222", 222000ul, 225000ul },
+  { "432", 420000ul, 450000ul }
+};
+
+/// copy @p str to @p out in upper case, reusing the memory of @p out
+void
+foldCase(const std::string &str, std::string &out)
+{
+  out.assign(str);
+  for (char &ch : out) {
+    ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+  }
+}
+
+std::string
+upperCase(const std::string &str)
+{
+  std::string result;
+  foldCase(str, result);
+  return result;
+}
+
+/// return the dense id of @p key in @p ids, adding it if it's new
+std::uint32_t
+internId(std::unordered_map<std::string, std::uint32_t> &ids, const std::string &key)
+{
+  const auto it(ids.find(key));
+  if (ids.end() != it) {
+    return it->second;
+  }
+  const std::uint32_t id(static_cast<std::uint32_t>(ids.size()));
+  ids.emplace(key, id);
+  return id;
+}
+
+/**
+ * @brief A set of 64-bit keys in one open addressed table, so adding
+ *        a key never allocates
+ */
+class KeySet {
+public:
+  /// a set with room for @p maxKeys keys
+  explicit KeySet(std::size_t maxKeys)
+    : d_shift(60u)
+  {
+    while ((std::size_t(1) << (64u - d_shift)) < 2u*maxKeys) {
+      --d_shift;
+    }
+    d_slots.assign(std::size_t(1) << (64u - d_shift), 0u);
+  }
+
+  /// add @p key and return true if it wasn't already in the set
+  bool insert(std::uint64_t key)
+  {
+    // zero marks an empty slot
+    const std::uint64_t stored(key + 1u);
+    const std::size_t mask(d_slots.size() - 1u);
+    for (std::size_t i = (stored * 0x9e3779b97f4a7c15ull) >> d_shift; ; i = (i + 1u) & mask) {
+      if (d_slots[i] == stored) {
+        return false;
+      }
+      if (0u == d_slots[i]) {
+        d_slots[i] = stored;
+        return true;
+      }
+    }
+  }
+private:
+  unsigned d_shift;
+  std::vector<std::uint64_t> d_slots;
+};
+
+std::vector<std::string>
+words(const std::string &str)
+{
+  std::istringstream in(str);
+  std::vector<std::string> result;
+  std::string word;
+  while (in >> word) {
+    result.push_back(word);
+  }
+  return result;
+}
+
+unsigned long
+parseNumber(const std::string &str, const std::string &tag)
+{
+  char *end(nullptr);
+  const unsigned long result(std::strtoul(str.c_str(), &end, 10));
+  if (str.empty() || (end && *end)) {
+    throw std::invalid_argument("Bad number for " + tag + ": " + str);
+  }
+  return result;
+}
+}
+
+Band
+cab::bandFromFrequency(const std::string &freq)
+{
+  const char *const text(freq.c_str());
+  char *end(nullptr);
+  const unsigned long value(std::strtoul(text, &end, 10));
+  if ((end == text) || (*end && !std::isspace(static_cast<unsigned char>(*end)))) {
+    return e_UnknownBand;
+  }
+  // VHF and up may be given as the band in MHz
+  const unsigned long kHz((value == 50ul) || (value == 144ul) ||
+                          (value == 222ul) || (value == 432ul) ?
+                          (value * 1000ul) : value);
+  for (unsigned band = 0u; band < e_NumBands; ++band) {
+    if ((kHz >= s_bands[band].lowKHz) && (kHz <= s_bands[band].highKHz)) {
+      return static_cast<Band>(band);
+    }
+  }
+  return e_UnknownBand;
+}
+
+const char *
+cab::bandName(Band band)
+{
+  return (band < e_NumBands) ? s_bands[band].name : "unknown";
+}
+
+ScoringRules
+cab::parseScoringRules(const std::string &text)
+{
+  ScoringRules rules;
+  for (const HeaderTag &tag : headerTags(text)) {
+    const std::string name(upperCase(tag.tag));
+    const std::vector<std::string> values(words(tag.value));
+    if ("COLUMNS" == name) {
+      if (values.size() != 4u) {
+        throw std::invalid_argument("COLUMNS needs four column numbers");
+      }
+      rules.freqColumn = parseNumber(values[0], name);
+      rules.modeColumn = parseNumber(values[1], name);
+      rules.callColumn = parseNumber(values[2], name);
+      rules.multColumn = parseNumber(values[3], name);
+    }
+    else if ("POINTS" == name) {
+      if (values.size() != 2u) {
+        throw std::invalid_argument("POINTS needs a mode and a number");
+      }
+      rules.points.push_back(ScoringRules::ModePoints{ upperCase(values[0]),
+                             static_cast<unsigned>(parseNumber(values[1], name)) });
+    }
+    else if ("DEFAULT-POINTS" == name) {
+      rules.defaultPoints = static_cast<unsigned>(parseNumber(tag.value, name));
+    }
+    else if ("MULT-SCOPE" == name) {
+      const std::string scope(upperCase(tag.value));
+      if ("BAND" == scope) {
+        rules.multScope = ScoringRules::MultScope::Band;
+      }
+      else if ("CONTEST" == scope) {
+        rules.multScope = ScoringRules::MultScope::Contest;
+      }
+      else {
+        throw std::invalid_argument("Unknown MULT-SCOPE: " + tag.value);
+      }
+    }
+    else if ("DUPE-SCOPE" == name) {
+      const std::string scope(upperCase(tag.value));
+      if ("BAND" == scope) {
+        rules.dupeScope = ScoringRules::DupeScope::Band;
+      }
+      else if ("BAND-MODE" == scope) {
+        rules.dupeScope = ScoringRules::DupeScope::BandMode;
+      }
+      else {
+        throw std::invalid_argument("Unknown DUPE-SCOPE: " + tag.value);
+      }
+    }
+    else if ("MULTIPLIERS" == name) {
+      rules.multipliers.insert(rules.multipliers.end(), values.begin(), values.end());
+    }
+    else if ("MULTIPLIER" == name) {
+      rules.multipliers.push_back(tag.value);
+    }
+    else {
+      throw std::invalid_argument("Unknown scoring rule: " + tag.tag);
+    }
+  }
+  return rules;
+}
+
+Scorer::Scorer(const ScoringRules &rules)
+  : d_rules(rules),
+    d_minColumns(1u + std::max(std::max(rules.freqColumn, rules.modeColumn),
+                               std::max(rules.callColumn, rules.multColumn)))
+{
+  for (const std::string &mult : d_rules.multipliers) {
+    const std::string name(upperCase(mult));
+    if (d_multIds.emplace(name, static_cast<int>(d_multNames.size())).second) {
+      d_multNames.push_back(name);
+    }
+  }
+  for (const ScoringRules::ModePoints &mp : d_rules.points) {
+    if (!d_points.emplace(upperCase(mp.mode), mp.points).second) {
+      throw std::invalid_argument("Points given twice for mode " + mp.mode);
+    }
+  }
+}
+
+int
+Scorer::multiplierId(const std::string &name) const
+{
+  const auto it(d_multIds.find(upperCase(name)));
+  return (d_multIds.end() == it) ? -1 : it->second;
+}
+
+unsigned
+Scorer::pointsFor(const std::string &mode) const
+{
+  const auto it(d_points.find(mode));
+  return (d_points.end() == it) ? d_rules.defaultPoints : it->second;
+}
+
+Score
+Scorer::score(const TableText::RowAndColumnList &rows) const
+{
+  const std::size_t wordsPerSet((d_multNames.size() + 63u) / 64u);
+  const bool perBand(ScoringRules::MultScope::Band == d_rules.multScope);
+  // one bitset of worked multipliers per band (or just one)
+  std::vector<std::uint64_t> worked((perBand ? static_cast<std::size_t>(e_NumBands) : 1u) *
+                                    wordsPerSet, 0u);
+  // case is folded once for each distinct callsign and mode of the
+  // log, and the contacts are compared by the ids given to them
+  std::unordered_map<std::string, std::uint32_t> callIds, modeIds;
+  std::vector<unsigned> modePoints;
+  KeySet contacts(rows.size());
+  const bool perMode(ScoringRules::DupeScope::BandMode == d_rules.dupeScope);
+  Score result;
+  std::string folded;
+  for (const auto &row : rows) {
+    if (row.size() < d_minColumns) {
+      ++result.invalid;
+      continue;
+    }
+    const Band band(bandFromFrequency(row[d_rules.freqColumn]));
+    if (e_UnknownBand == band) {
+      ++result.invalid;
+      continue;
+    }
+    foldCase(row[d_rules.callColumn], folded);
+    const std::uint64_t call(internId(callIds, folded));
+    foldCase(row[d_rules.modeColumn], folded);
+    const std::uint32_t mode(internId(modeIds, folded));
+    if (mode == modePoints.size()) {
+      modePoints.push_back(pointsFor(folded));
+    }
+    // the band fits in the low four bits
+    const std::uint64_t key((call << 32) | (perMode ? (std::uint64_t(mode) << 4) : 0u) |
+                            static_cast<std::uint64_t>(band));
+    if (!contacts.insert(key)) {
+      ++result.dupes;
+      continue;
+    }
+    ++result.qsos;
+    result.qsoPoints += modePoints[mode];
+    foldCase(row[d_rules.multColumn], folded);
+    const auto multIt(d_multIds.find(folded));
+    const int mult((d_multIds.end() == multIt) ? -1 : multIt->second);
+    if (mult >= 0) {
+      const std::size_t set(perBand ? static_cast<std::size_t>(band) : 0u);
+      worked[set * wordsPerSet + (mult >> 6)] |= (std::uint64_t(1) << (mult & 63));
+    }
+  }
+  for (const std::uint64_t word : worked) {
+    result.multipliers += std::bitset<64>(word).count();
+  }
+  result.claimed = result.qsoPoints * result.multipliers;
+  return result;
+}
+
+std::vector<Score>
+Scorer::scoreAll(const std::vector<const TableText::RowAndColumnList *> &logs,
+                 unsigned numThreads) const
+{
+  std::vector<Score> result(logs.size());
+  if (0u == numThreads) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  numThreads = static_cast<unsigned>(std::min<std::size_t>(numThreads, logs.size()));
+  // each thread takes the next unscored log until there are none left
+  std::atomic<std::size_t> next(0u);
+  std::mutex errorMutex;
+  std::exception_ptr error;
+  auto worker = [&]() {
+    for (std::size_t i = next++; i < logs.size(); i = next++) {
+      try {
+        if (!logs[i]) {
+          throw std::invalid_argument("No rows given for log " + std::to_string(i));
+        }
+        result[i] = score(*logs[i]);
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        // the other threads stop after their current log
+        next = logs.size();
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1u; i < numThreads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return result;
+}
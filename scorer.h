@@ -0,0 +1,156 @@
+/**
+ * @file   scorer.h
+ * @brief  Compute claimed scores from tabulated QSO lines
+ *
+ * A contest score is typically the number of QSO points times the
+ * number of multipliers (e.g., states, counties or countries) worked.
+ * The contest specific details are held in a ScoringRules table, so
+ * every log of a season can be scored again quickly after a rule
+ * changes. Multiplier names are mapped to dense integer ids, and the
+ * multipliers worked are tracked in one bitset per band.
+ */
+#ifndef __SCORER_H_LOADED__
+#define __SCORER_H_LOADED__
+#include "tabletext.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cab {
+
+/// An amateur radio band. e_UnknownBand is used for frequencies outside them.
+enum Band {
+  e_160m, e_80m, e_60m, e_40m, e_30m, e_20m, e_17m, e_15m, e_12m, e_10m,
+  e_6m, e_2m, e_222MHz, e_432MHz, e_UnknownBand, e_NumBands = e_UnknownBand
+};
+
+/**
+ * @brief return the band for a Cabrillo frequency field. HF
+ *        frequencies are in kHz (e.g., 14025). VHF bands may be
+ *        given as the band in MHz (e.g., 50 or 144).
+ */
+Band bandFromFrequency(const std::string &freq);
+
+/**
+ * @brief return the name of @p band (e.g., "20m")
+ */
+const char *bandName(Band band);
+
+/**
+ * @brief The rules for scoring one contest
+ */
+struct ScoringRules {
+  /// The QSO points for a Cabrillo mode (e.g., CW, PH, RY, DG)
+  struct ModePoints {
+    std::string mode;
+    unsigned points;
+  };
+
+  /// where the multipliers are counted
+  enum class MultScope {
+    Band,                       ///< each multiplier counts once per band
+    Contest                     ///< each multiplier counts once
+  };
+
+  /// which repeat contacts are duplicates that score nothing
+  enum class DupeScope {
+    Band,                       ///< the same station on the same band
+    BandMode                    ///< the same station on the same band and mode
+  };
+
+  std::size_t freqColumn = 1u;
+  std::size_t modeColumn = 2u;
+  std::size_t callColumn = 8u;
+  std::size_t multColumn = 10u;
+  std::vector<ModePoints> points;
+  /// the points for a mode that's not in @c points
+  unsigned defaultPoints = 1u;
+  MultScope multScope = MultScope::Contest;
+  DupeScope dupeScope = DupeScope::BandMode;
+  /// the valid multipliers. Other values in the multiplier column don't count.
+  std::vector<std::string> multipliers;
+};
+
+/**
+ * @brief read rules written as tag lines, for example
+ * @code
+ * COLUMNS: 1 2 8 10
+ * POINTS: CW 3
+ * POINTS: PH 2
+ * DEFAULT-POINTS: 1
+ * MULT-SCOPE: BAND
+ * DUPE-SCOPE: BAND-MODE
+ * MULTIPLIERS: AL AK AZ AR
+ * MULTIPLIERS: ORAN SCLA
+ * @endcode
+ * COLUMNS gives the frequency, mode, callsign and multiplier columns.
+ * Multiplier names with spaces may be given one per MULTIPLIER: line.
+ * @exception std::invalid_argument  an unknown tag or a bad value
+ */
+ScoringRules parseScoringRules(const std::string &text);
+
+/**
+ * @brief The claimed score of one log
+ */
+struct Score {
+  std::size_t qsos = 0u;        ///< QSO lines that score
+  std::size_t dupes = 0u;       ///< QSO lines that are duplicates
+  std::size_t invalid = 0u;     ///< QSO lines with too few columns or an unknown band
+  std::uint64_t qsoPoints = 0u;
+  std::size_t multipliers = 0u;
+  std::uint64_t claimed = 0u;   ///< qsoPoints * multipliers
+};
+
+class Scorer {
+public:
+  /**
+   * @exception std::invalid_argument  the rules are inconsistent
+   */
+  explicit Scorer(const ScoringRules &rules);
+
+  /**
+   * @brief return the dense id of a multiplier or -1 if it's not one.
+   *        Case is ignored.
+   */
+  int multiplierId(const std::string &name) const;
+
+  std::size_t getNumMultipliers() const noexcept
+  {
+    return d_multNames.size();
+  }
+
+  /**
+   * @brief score one tabulated log. This may be called from many
+   *        threads at once.
+   */
+  Score score(const TableText::RowAndColumnList &rows) const;
+
+  /**
+   * @brief score many logs using up to @p numThreads threads (zero
+   *        means one per processor).
+   * @return the scores in the same order as @p logs
+   * @exception std::invalid_argument  a pointer in @p logs is null.
+   *            An exception thrown while scoring any log is passed on
+   *            once all the threads have stopped.
+   */
+  std::vector<Score>
+  scoreAll(const std::vector<const TableText::RowAndColumnList *> &logs,
+           unsigned numThreads = 0u) const;
+private:
+  Scorer() = delete;
+
+  /// the QSO points for @p mode, which must be in upper case
+  unsigned pointsFor(const std::string &mode) const;
+
+  ScoringRules d_rules;
+  /// the upper case multiplier names indexed by id
+  std::vector<std::string> d_multNames;
+  std::unordered_map<std::string, int> d_multIds;
+  std::unordered_map<std::string, unsigned> d_points;
+  std::size_t d_minColumns;
+};
+}
+
+#endif /*  __SCORER_H_LOADED__ */
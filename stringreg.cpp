@@ -1,5 +1,10 @@
 #include "stringreg.h"
-#include <regex>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 std::string
 cab::translateeol(const std::string &str)
@@ -51,32 +56,171 @@ cab::translateeol(const std::string &str)
   return result;
 }
 
+namespace {
+/**
+ * @brief call @p func with the start and end (excluding the newline) of
+ *        each line of @p str and whether a newline follows
+ */
+template <typename LineFunc>
+void
+forEachLine(const std::string &str, LineFunc &&func)
+{
+  const char *cur(str.data());
+  const char *const end(cur + str.size());
+  while (cur < end) {
+    const char *const next(static_cast<const char *>(std::memchr(cur, '\n', end - cur)));
+    const char *const lineEnd(next ? next : end);
+    func(cur, lineEnd, nullptr != next);
+    cur = (next ? (next + 1) : end);
+  }
+}
+}
+
 std::string
 cab::removeSpaceBeforeTags(const std::string &str)
 {
-  static const std::regex leadingSpace("(^|\n)[ \\t]+([a-z]+(-[a-z]+)*:)",
-                                       std::regex::ECMAScript | std::regex::icase |
-                                       std::regex::optimize);
-  return std::regex_replace(str, leadingSpace, "$1$2");
+  std::string result;
+  result.reserve(str.size());
+  forEachLine(str, [&result](const char *line, const char *lineEnd, bool newline) {
+    const char *first(line);
+    while ((first < lineEnd) && ((' ' == *first) || ('\t' == *first))) {
+      ++first;
+    }
+    if ((first > line) && (TagId::None != recognizeTag(first, lineEnd))) {
+      line = first;
+    }
+    result.append(line, lineEnd);
+    if (newline) {
+      result.push_back('\n');
+    }
+  });
+  return result;
 }
 
 std::string
 cab::removeXQSOLines(const std::string &str)
 {
-  static const std::regex xqsoLine("(^|\n)x-qso:.*\n",
-                                   std::regex::ECMAScript | std::regex::icase |
-                                   std::regex::optimize);
-  return std::regex_replace(str, xqsoLine, "$1");
-
+  std::string result;
+  result.reserve(str.size());
+  forEachLine(str, [&result](const char *line, const char *lineEnd, bool newline) {
+    // only complete lines are removed
+    if (!newline || (TagId::XQso != recognizeTag(line, lineEnd))) {
+      result.append(line, lineEnd);
+      if (newline) {
+        result.push_back('\n');
+      }
+    }
+  });
+  return result;
 }
 
 std::string
 cab::fixWrappedLines(const std::string &str)
 {
-  static const std::regex lineEndWithNoTag("\\n(?![a-z]+(-[a-z]+)*:)",
-      std::regex::ECMAScript | std::regex::icase |
-      std::regex::optimize);
-  return std::regex_replace(str, lineEndWithNoTag, "");
+  std::string result;
+  result.reserve(str.size());
+  bool pendingNewline(false);
+  forEachLine(str, [&result, &pendingNewline](const char *line, const char *lineEnd,
+  bool newline) {
+    // a line that doesn't start with a tag continues the line before it
+    if (pendingNewline && (TagId::None != recognizeTag(line, lineEnd))) {
+      result.push_back('\n');
+    }
+    result.append(line, lineEnd);
+    pendingNewline = newline;
+  });
+  return result;
+}
+
+const cab::HeaderTag *
+cab::findTag(const HeaderList &header, TagId id) noexcept
+{
+  for (const HeaderTag &tag : header) {
+    if (id == tag.id) {
+      return &tag;
+    }
+  }
+  return nullptr;
+}
+
+cab::HeaderList
+cab::headerTags(const std::string &str)
+{
+  HeaderList result;
+  forEachLine(str, [&result](const char *line, const char *lineEnd, bool) {
+    std::size_t length(0u);
+    const TagId id(recognizeTag(line, lineEnd, &length));
+    if ((TagId::None != id) && (TagId::Qso != id) && (TagId::XQso != id)) {
+      result.push_back(HeaderTag{ std::string(line, length),
+                                  cab::trim(std::string(line + length + 1, lineEnd)), id });
+    }
+  });
+  return result;
+}
+
+std::string
+cab::qsoLines(const std::string &str)
+{
+  std::string result;
+  result.reserve(str.size());
+  forEachLine(str, [&result](const char *line, const char *lineEnd, bool) {
+    if (TagId::Qso == recognizeTag(line, lineEnd)) {
+      result.append(line, lineEnd);
+      result.push_back('\n');
+    }
+  });
+  return result;
+}
+
+std::string
+cab::normalizeLog(const std::string &str)
+{
+  std::string result(fixWrappedLines(removeSpaceBeforeTags(translateeol(str))));
+  if (!result.empty() && ('\n' != result.back())) {
+    // removeXQSOLines needs the last line to be terminated
+    result.push_back('\n');
+  }
+  return removeXQSOLines(result);
+}
+
+bool
+cab::isPlainASCII(const char *str, std::size_t len) noexcept
+{
+  const char *const end(str + len);
+#if defined(__SSE2__)
+  const __m128i tabs(_mm_set1_epi8('\t'));
+  for (; (end - str) >= 64; str += 64) {
+    const __m128i a(_mm_loadu_si128(reinterpret_cast<const __m128i *>(str)));
+    const __m128i b(_mm_loadu_si128(reinterpret_cast<const __m128i *>(str + 16)));
+    const __m128i c(_mm_loadu_si128(reinterpret_cast<const __m128i *>(str + 32)));
+    const __m128i d(_mm_loadu_si128(reinterpret_cast<const __m128i *>(str + 48)));
+    // the sign bit is set for non-ASCII bytes and for tabs
+    const __m128i bad(_mm_or_si128(_mm_or_si128(_mm_or_si128(a, _mm_cmpeq_epi8(a, tabs)),
+                                                _mm_or_si128(b, _mm_cmpeq_epi8(b, tabs))),
+                                   _mm_or_si128(_mm_or_si128(c, _mm_cmpeq_epi8(c, tabs)),
+                                                _mm_or_si128(d, _mm_cmpeq_epi8(d, tabs)))));
+    if (_mm_movemask_epi8(bad)) {
+      return false;
+    }
+  }
+#endif
+  static const std::uint64_t ones(0x0101010101010101ull);
+  static const std::uint64_t highBits(0x8080808080808080ull);
+  for (; (end - str) >= 8; str += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, str, sizeof(word));
+    const std::uint64_t tabBytes(word ^ (ones * '\t'));
+    // a byte of tabBytes is zero where word has a tab
+    if ((word | ((tabBytes - ones) & ~tabBytes)) & highBits) {
+      return false;
+    }
+  }
+  for (; str < end; ++str) {
+    if (('\t' == *str) || (*str & 0x80)) {
+      return false;
+    }
+  }
+  return true;
 }
 
 std::string
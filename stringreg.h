@@ -5,10 +5,31 @@
 
 #ifndef __STRINGREG_H_LOADED__
 #define __STRINGREG_H_LOADED__
+#include "tagid.h"
+
 #include <string>
+#include <vector>
 
 namespace cab {
 
+/**
+ * @brief a header tag and its value from a log (e.g., CALLSIGN: W1AW)
+ */
+struct HeaderTag {
+  std::string tag;
+  std::string value;
+  /// the tag classified by recognizeTag()
+  TagId id;
+};
+
+using HeaderList = std::vector<HeaderTag>;
+
+/**
+ * @brief return the first tag of kind @p id in @p header, or nullptr if
+ *        there is none
+ */
+const HeaderTag *findTag(const HeaderList &header, TagId id) noexcept;
+
 /**
  * @brief convert the end of line convention to only newline
  */
@@ -27,6 +48,34 @@ std::string fixWrappedLines(const std::string &str);
  */
 std::string removeXQSOLines(const std::string &str);
 
+/**
+ * @brief collect the tags and values of all the tag lines except
+ *        QSO: and X-QSO: lines. The end of lines must already be
+ *        translated.
+ */
+HeaderList headerTags(const std::string &str);
+
+/**
+ * @brief collect the QSO: lines, each terminated by a newline. The end
+ *        of lines must already be translated.
+ */
+std::string qsoLines(const std::string &str);
+
+/**
+ * @brief apply all of the regularizations to a log as it was submitted:
+ *        translate the end of lines, remove space before tags, fix
+ *        wrapped lines and remove X-QSO: lines. The result always ends
+ *        with a newline unless it's empty.
+ */
+std::string normalizeLog(const std::string &str);
+
+/**
+ * @brief return true if the @p len characters starting at @p str are
+ *        7-bit ASCII with no horizontal tabs. This uses SIMD instructions
+ *        when they are available.
+ */
+bool isPlainASCII(const char *str, std::size_t len) noexcept;
+
 /**
  * @brief trim leading and trailing whitespace from string
  */
@@ -0,0 +1,302 @@
+#include "tablecache.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace cab;
+
+const std::uint32_t TableCache::s_version(1u);
+
+namespace {
+const char s_magic[8] = { 'C', 'A', 'B', 'T', 'B', 'L', '\r', '\n' };
+const std::uint32_t s_byteOrder(0x01020304u);
+
+/// The fixed size header at the start of every cache file
+struct CacheHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint64_t sourceHash;
+  std::uint64_t sourceLength;
+  std::uint64_t payloadHash;
+  std::uint64_t payloadLength;
+  std::uint32_t numRows;
+  std::uint32_t numColumns;
+  std::uint32_t numTags;
+  std::uint32_t reserved;
+};
+
+static_assert(sizeof(CacheHeader) == 64u, "CacheHeader must not have padding");
+
+void
+append32(std::string &buf, std::uint32_t value)
+{
+  buf.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void
+store64(std::string &buf, std::size_t offset, std::uint64_t value)
+{
+  std::memcpy(&buf[offset], &value, sizeof(value));
+}
+
+/// sections start on eight byte boundaries
+void
+align8(std::string &buf)
+{
+  buf.resize((buf.size() + 7u) & ~static_cast<std::size_t>(7u), '\0');
+}
+
+std::uint32_t
+checked32(std::size_t value)
+{
+  if (value > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("Table is too large for the cache format");
+  }
+  return static_cast<std::uint32_t>(value);
+}
+
+[[noreturn]] void
+badCache(const std::string &why)
+{
+  throw std::runtime_error("Invalid table cache: " + why);
+}
+
+/**
+ * @brief return true if the @p count offsets at @p data start at zero,
+ *        never decrease, and end at most @p limit
+ */
+bool
+validOffsets(const char *data, std::size_t count, std::size_t limit) noexcept
+{
+  std::uint32_t prev(0u);
+  for (std::size_t i = 0u; i < count; ++i) {
+    std::uint32_t offset;
+    std::memcpy(&offset, data + 4u*i, sizeof(offset));
+    if ((i ? (offset < prev) : (0u != offset)) || (offset > limit)) {
+      return false;
+    }
+    prev = offset;
+  }
+  return true;
+}
+}
+
+void
+cab::writeTableCache(const std::string                 &path,
+                     const std::string                 &source,
+                     const HeaderList                  &header,
+                     const TableText::ColumnLayout     &layout,
+                     const TableText::RowAndColumnList &rows)
+{
+  std::size_t cellBytes(0u);
+  for (const auto &row : rows) {
+    for (const auto &cell : row) {
+      cellBytes += cell.size();
+    }
+  }
+  std::string buf;
+  buf.reserve(sizeof(CacheHeader) + 16u*layout.size() +
+              4u*(rows.size()+2u)*layout.size() + cellBytes);
+  buf.resize(sizeof(CacheHeader), '\0');
+
+  // column layout
+  for (const auto &cr : layout) {
+    append32(buf, checked32(cr.begin));
+    append32(buf, checked32(cr.end));
+  }
+  align8(buf);
+
+  // header tags: offsets into the tag text followed by the tag text
+  std::uint32_t tagOffset(0u);
+  append32(buf, 0u);
+  for (const auto &tag : header) {
+    tagOffset = checked32(tagOffset + tag.tag.size());
+    append32(buf, tagOffset);
+    tagOffset = checked32(tagOffset + tag.value.size());
+    append32(buf, tagOffset);
+  }
+  for (const auto &tag : header) {
+    buf.append(tag.tag);
+    buf.append(tag.value);
+  }
+  align8(buf);
+
+  // column directory followed by each column
+  const std::size_t directory(buf.size());
+  buf.resize(directory + 8u*layout.size(), '\0');
+  for (std::size_t col = 0u; col < layout.size(); ++col) {
+    align8(buf);
+    store64(buf, directory + 8u*col, buf.size());
+    std::uint32_t offset(0u);
+    append32(buf, 0u);
+    for (const auto &row : rows) {
+      if (col < row.size()) {
+        offset = checked32(offset + row[col].size());
+      }
+      append32(buf, offset);
+    }
+    for (const auto &row : rows) {
+      if (col < row.size()) {
+        buf.append(row[col]);
+      }
+    }
+  }
+  align8(buf);
+
+  CacheHeader hdr;
+  std::memcpy(hdr.magic, s_magic, sizeof(hdr.magic));
+  hdr.version = TableCache::s_version;
+  hdr.byteOrder = s_byteOrder;
+  hdr.sourceHash = hash64(source.data(), source.size());
+  hdr.sourceLength = source.size();
+  hdr.payloadLength = buf.size() - sizeof(CacheHeader);
+  hdr.payloadHash = hash64(buf.data() + sizeof(CacheHeader), hdr.payloadLength);
+  hdr.numRows = checked32(rows.size());
+  hdr.numColumns = checked32(layout.size());
+  hdr.numTags = checked32(header.size());
+  hdr.reserved = 0u;
+  std::memcpy(&buf[0], &hdr, sizeof(hdr));
+  replaceFile(path, buf);
+}
+
+TableCache::TableCache(const std::string &path, bool verify)
+  : d_file(path)
+{
+  CacheHeader hdr;
+  if (d_file.size() < sizeof(hdr)) {
+    badCache("file is too short");
+  }
+  std::memcpy(&hdr, d_file.data(), sizeof(hdr));
+  if (std::memcmp(hdr.magic, s_magic, sizeof(s_magic))) {
+    badCache("wrong magic number");
+  }
+  if (s_byteOrder != hdr.byteOrder) {
+    badCache("wrong byte order");
+  }
+  if (s_version != hdr.version) {
+    badCache("unsupported version " + std::to_string(hdr.version));
+  }
+  if (hdr.payloadLength != (d_file.size() - sizeof(hdr))) {
+    badCache("wrong length");
+  }
+  if (verify &&
+      (hdr.payloadHash != hash64(d_file.data() + sizeof(hdr), hdr.payloadLength))) {
+    badCache("checksum mismatch");
+  }
+  d_sourceHash = hdr.sourceHash;
+  d_sourceLength = hdr.sourceLength;
+  d_numRows = hdr.numRows;
+  d_numColumns = hdr.numColumns;
+  d_numTags = hdr.numTags;
+  d_tagSection = sizeof(hdr) + ((8u*d_numColumns + 7u) & ~static_cast<std::size_t>(7u));
+  const std::size_t tagOffsets(4u*(2u*d_numTags + 1u));
+  if ((d_tagSection + tagOffsets) > d_file.size()) {
+    badCache("truncated header tags");
+  }
+  // the offsets are always checked, so a damaged file can't cause
+  // reads outside the mapping even without the hash
+  if (!validOffsets(d_file.data() + d_tagSection, 2u*d_numTags + 1u,
+                    d_file.size() - d_tagSection - tagOffsets)) {
+    badCache("bad header tag offsets");
+  }
+  const std::size_t tagEnd(d_tagSection + tagOffsets + load32(d_tagSection + tagOffsets - 4u));
+  d_columnSection = (tagEnd + 7u) & ~static_cast<std::size_t>(7u);
+  if ((d_columnSection + 8u*d_numColumns) > d_file.size()) {
+    badCache("truncated column directory");
+  }
+  for (std::size_t col = 0u; col < d_numColumns; ++col) {
+    const std::uint64_t start(load64(d_columnSection + 8u*col));
+    const std::size_t offsets(4u*(d_numRows + 1u));
+    if ((start > d_file.size()) || ((d_file.size() - start) < offsets)) {
+      badCache("truncated column " + std::to_string(col));
+    }
+    if (!validOffsets(d_file.data() + start, d_numRows + 1u,
+                      d_file.size() - start - offsets)) {
+      badCache("bad cell offsets in column " + std::to_string(col));
+    }
+  }
+}
+
+std::uint32_t
+TableCache::load32(std::size_t offset) const noexcept
+{
+  std::uint32_t value;
+  std::memcpy(&value, d_file.data() + offset, sizeof(value));
+  return value;
+}
+
+std::uint64_t
+TableCache::load64(std::size_t offset) const noexcept
+{
+  std::uint64_t value;
+  std::memcpy(&value, d_file.data() + offset, sizeof(value));
+  return value;
+}
+
+bool
+TableCache::isCurrent(const std::string &source) const noexcept
+{
+  return (source.size() == d_sourceLength) &&
+         (hash64(source.data(), source.size()) == d_sourceHash);
+}
+
+TableText::ColumnLayout
+TableCache::getLayout() const
+{
+  TableText::ColumnLayout layout;
+  layout.reserve(d_numColumns);
+  for (std::size_t col = 0u; col < d_numColumns; ++col) {
+    const std::size_t pos(sizeof(CacheHeader) + 8u*col);
+    layout.push_back(TableText::ColumnRange{ load32(pos), load32(pos + 4u) });
+  }
+  return layout;
+}
+
+HeaderList
+TableCache::getHeader() const
+{
+  HeaderList result;
+  result.reserve(d_numTags);
+  const char *const text(d_file.data() + d_tagSection + 4u*(2u*d_numTags + 1u));
+  for (std::size_t i = 0u; i < d_numTags; ++i) {
+    const std::uint32_t tagStart(load32(d_tagSection + 8u*i));
+    const std::uint32_t valueStart(load32(d_tagSection + 8u*i + 4u));
+    const std::uint32_t valueEnd(load32(d_tagSection + 8u*i + 8u));
+    std::string tag(text + tagStart, text + valueStart);
+    const TagId id(tagIdFromName(tag));
+    result.push_back(HeaderTag{ std::move(tag), std::string(text + valueStart, text + valueEnd),
+                                id });
+  }
+  return result;
+}
+
+TableText::FieldSpan
+TableCache::getCell(std::size_t row, std::size_t col) const
+{
+  if ((row >= d_numRows) || (col >= d_numColumns)) {
+    throw std::out_of_range("Cell is outside the cached table");
+  }
+  const std::size_t start(load64(d_columnSection + 8u*col));
+  const std::uint32_t begin(load32(start + 4u*row));
+  const std::uint32_t end(load32(start + 4u*row + 4u));
+  return TableText::FieldSpan{ d_file.data() + start + 4u*(d_numRows + 1u) + begin,
+                               end - begin };
+}
+
+TableText::RowAndColumnList
+TableCache::getRows() const
+{
+  TableText::RowAndColumnList result(d_numRows);
+  for (auto &row : result) {
+    row.reserve(d_numColumns);
+  }
+  for (std::size_t col = 0u; col < d_numColumns; ++col) {
+    for (std::size_t row = 0u; row < d_numRows; ++row) {
+      const TableText::FieldSpan cell(getCell(row, col));
+      result[row].emplace_back(cell.data, cell.length);
+    }
+  }
+  return result;
+}
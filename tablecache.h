@@ -0,0 +1,117 @@
+/**
+ * @file   tablecache.h
+ * @brief  A binary file format that caches a tabulated log
+ *
+ * Parsing a log involves end of line translation, several regular
+ * expression passes, counting spaces, and searching for the column
+ * thresholds. When the same archived log is examined many times, it's
+ * much cheaper to save the result once and map it back into memory.
+ *
+ * The file starts with a fixed size header that holds a magic string,
+ * the format version, a hash of the source text (to detect a cache
+ * that no longer matches its log), and a hash of the rest of the file
+ * (to detect corruption). The rest of the file holds the column
+ * layout, the header tags, and the cell data stored column by
+ * column. Each column is an array of numRows+1 offsets followed by
+ * the characters of its cells, so any cell can be read straight from
+ * the mapped file without copying.
+ */
+#ifndef __TABLECACHE_H_LOADED__
+#define __TABLECACHE_H_LOADED__
+#include "filemap.h"
+#include "stringreg.h"
+#include "tabletext.h"
+
+#include <cstdint>
+#include <string>
+
+namespace cab {
+
+/**
+ * @brief Write a cache file for a tabulated log.
+ * @param path    the name of the cache file to write
+ * @param source  the text that was parsed to produce the table. Only
+ *                its length and hash are stored.
+ * @param header  the header tags of the log
+ * @param layout  the column layout used to produce @p rows
+ * @param rows    the tabulated rows
+ * @exception std::system_error  the file could not be written
+ * @exception std::length_error  the table is too large for the format
+ */
+void
+writeTableCache(const std::string                 &path,
+                const std::string                 &source,
+                const HeaderList                  &header,
+                const TableText::ColumnLayout     &layout,
+                const TableText::RowAndColumnList &rows);
+
+/**
+ * @brief Read-only access to a cache file written by writeTableCache.
+ *
+ * The file is memory mapped, and the cells are returned as spans
+ * into the mapping. They remain valid as long as this object exists.
+ */
+class TableCache {
+public:
+  /// the version of the file format written by writeTableCache
+  static const std::uint32_t s_version;
+
+  /**
+   * @brief open the cache file @p path
+   * @param verify  when true, the hash of the whole file is checked.
+   *                The offsets of the tags and cells are always
+   *                checked against the size of the file.
+   * @exception std::system_error   the file could not be opened
+   * @exception std::runtime_error  the file is not a valid cache file,
+   *            has the wrong version, or is corrupt
+   */
+  explicit TableCache(const std::string &path, bool verify = true);
+
+  /**
+   * @brief return true if the cache was made from the text @p source
+   */
+  bool isCurrent(const std::string &source) const noexcept;
+
+  std::size_t getNumRows() const noexcept
+  {
+    return d_numRows;
+  }
+
+  std::size_t getNumColumns() const noexcept
+  {
+    return d_numColumns;
+  }
+
+  /// the column layout stored in the cache
+  TableText::ColumnLayout getLayout() const;
+
+  /// the header tags stored in the cache
+  HeaderList getHeader() const;
+
+  /// the contents of one cell without copying
+  TableText::FieldSpan
+  getCell(std::size_t row, std::size_t col) const;
+
+  /// copy the whole table
+  TableText::RowAndColumnList getRows() const;
+private:
+  TableCache() = delete;
+
+  std::uint32_t load32(std::size_t offset) const noexcept;
+
+  std::uint64_t load64(std::size_t offset) const noexcept;
+
+  MappedFile d_file;
+  std::uint64_t d_sourceHash;
+  std::uint64_t d_sourceLength;
+  std::size_t d_numRows;
+  std::size_t d_numColumns;
+  std::size_t d_numTags;
+  /// offset of the tag offsets array
+  std::size_t d_tagSection;
+  /// offset of the column directory
+  std::size_t d_columnSection;
+};
+}
+
+#endif /*  __TABLECACHE_H_LOADED__ */
@@ -0,0 +1,181 @@
+#include "tableexport.h"
+
+using namespace cab;
+
+TableExporter::TableExporter(OutputBuffer                   &out,
+                             Format                          format,
+                             const std::vector<std::string> &columnNames)
+  : d_out(out),
+    d_format(format),
+    d_columnNames(columnNames),
+    d_numRows(0u)
+{
+  if ((Format::JSONLines != d_format) && !d_columnNames.empty()) {
+    for (std::size_t col = 0u; col < d_columnNames.size(); ++col) {
+      writeField(col, d_columnNames[col].data(), d_columnNames[col].size());
+    }
+    d_out.put('\n');
+  }
+}
+
+void
+TableExporter::writeRow(const TableText::SpanRow &row)
+{
+  beginRow();
+  for (std::size_t col = 0u; col < row.size(); ++col) {
+    writeField(col, row[col].data, row[col].length);
+  }
+  endRow();
+}
+
+void
+TableExporter::writeRow(const std::vector<std::string> &row)
+{
+  beginRow();
+  for (std::size_t col = 0u; col < row.size(); ++col) {
+    writeField(col, row[col].data(), row[col].size());
+  }
+  endRow();
+}
+
+void
+TableExporter::writeTable(const TableText::RowAndColumnList &rows)
+{
+  for (const auto &row : rows) {
+    writeRow(row);
+  }
+}
+
+void
+TableExporter::writeTable(const TableText &table, const TableText::ColumnLayout &layout)
+{
+  table.forEachRow(layout, [this](const TableText::SpanRow &row) {
+    writeRow(row);
+  });
+}
+
+void
+TableExporter::beginRow()
+{
+  if (Format::JSONLines == d_format) {
+    d_out.put(d_columnNames.empty() ? '[' : '{');
+  }
+}
+
+void
+TableExporter::writeField(std::size_t col, const char *data, std::size_t len)
+{
+  if (col) {
+    d_out.put((Format::TSV == d_format) ? '\t' : ',');
+  }
+  if (Format::CSV == d_format) {
+    writeCSVField(data, len);
+  }
+  else if (Format::TSV == d_format) {
+    writeTSVField(data, len);
+  }
+  else {
+    if (!d_columnNames.empty()) {
+      if (col < d_columnNames.size()) {
+        writeJSONString(d_columnNames[col].data(), d_columnNames[col].size());
+      }
+      else {
+        // extra columns get their position as the key
+        const std::string key(std::to_string(col));
+        writeJSONString(key.data(), key.size());
+      }
+      d_out.put(':');
+    }
+    writeJSONString(data, len);
+  }
+}
+
+void
+TableExporter::endRow()
+{
+  if (Format::JSONLines == d_format) {
+    d_out.put(d_columnNames.empty() ? ']' : '}');
+  }
+  d_out.put('\n');
+  ++d_numRows;
+}
+
+void
+TableExporter::writeCSVField(const char *data, std::size_t len)
+{
+  const char *const end(data + len);
+  const char *cur(data);
+  while ((cur < end) && ('"' != *cur) && (',' != *cur) &&
+         ('\n' != *cur) && ('\r' != *cur)) {
+    ++cur;
+  }
+  if (cur == end) {
+    d_out.append(data, len);
+  }
+  else {
+    d_out.put('"');
+    for (cur = data; cur < end; ++cur) {
+      if ('"' == *cur) {
+        d_out.put('"');
+      }
+      d_out.put(*cur);
+    }
+    d_out.put('"');
+  }
+}
+
+void
+TableExporter::writeTSVField(const char *data, std::size_t len)
+{
+  const char *const end(data + len);
+  const char *run(data);         // start of characters that need no escape
+  for (const char *cur = data; cur < end; ++cur) {
+    const char ch(*cur);
+    if (('\t' == ch) || ('\n' == ch) || ('\r' == ch) || ('\\' == ch)) {
+      d_out.append(run, cur - run);
+      run = cur + 1;
+      d_out.put('\\');
+      d_out.put(('\t' == ch) ? 't' : (('\n' == ch) ? 'n' : (('\r' == ch) ? 'r' : '\\')));
+    }
+  }
+  d_out.append(run, end - run);
+}
+
+void
+TableExporter::writeJSONString(const char *data, std::size_t len)
+{
+  static const char hexDigits[] = "0123456789abcdef";
+  const char *const end(data + len);
+  const char *run(data);         // start of characters that need no escape
+  d_out.put('"');
+  for (const char *cur = data; cur < end; ++cur) {
+    const unsigned char ch(static_cast<unsigned char>(*cur));
+    if (('"' == ch) || ('\\' == ch) || (ch < 0x20u)) {
+      d_out.append(run, cur - run);
+      run = cur + 1;
+      d_out.put('\\');
+      switch (ch) {
+      case '"':
+      case '\\':
+        d_out.put(static_cast<char>(ch));
+        break;
+      case '\n':
+        d_out.put('n');
+        break;
+      case '\t':
+        d_out.put('t');
+        break;
+      case '\r':
+        d_out.put('r');
+        break;
+      default:
+        d_out.append("u00", 3u);
+        d_out.put(hexDigits[ch >> 4]);
+        d_out.put(hexDigits[ch & 0xfu]);
+        break;
+      }
+    }
+  }
+  d_out.append(run, end - run);
+  d_out.put('"');
+}
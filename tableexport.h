@@ -0,0 +1,77 @@
+/**
+ * @file   tableexport.h
+ * @brief  Write tabulated rows as CSV, TSV or JSON lines
+ *
+ * The writer works directly from the fields of a tabulated log
+ * without creating a temporary string per cell. Fields are quoted or
+ * escaped into an OutputBuffer that is handed to the operating system
+ * in large pieces.
+ */
+#ifndef __TABLEEXPORT_H_LOADED__
+#define __TABLEEXPORT_H_LOADED__
+#include "outputbuffer.h"
+#include "tabletext.h"
+
+#include <string>
+#include <vector>
+
+namespace cab {
+
+class TableExporter {
+public:
+  enum class Format {
+    CSV,                        ///< RFC 4180 comma separated values
+    JSONLines,                  ///< one JSON array or object per line
+    TSV                         ///< tab separated with \\t, \\n, \\r and \\\\ escapes
+  };
+
+  /**
+   * @brief write rows to @p out in the format @p format
+   * @param columnNames  if not empty, CSV and TSV output start with a line of
+   *                     column names, and JSON lines output uses objects
+   *                     with these keys instead of arrays.
+   */
+  TableExporter(OutputBuffer                   &out,
+                Format                          format,
+                const std::vector<std::string> &columnNames = std::vector<std::string>());
+
+  /// write one row of fields
+  void writeRow(const TableText::SpanRow &row);
+
+  /// write one row of fields
+  void writeRow(const std::vector<std::string> &row);
+
+  /// write every row of an already tabulated table
+  void writeTable(const TableText::RowAndColumnList &rows);
+
+  /// tabulate @p table with @p layout and write the rows as they're produced
+  void writeTable(const TableText &table, const TableText::ColumnLayout &layout);
+
+  /// the number of rows written so far
+  std::size_t getNumRows() const noexcept
+  {
+    return d_numRows;
+  }
+private:
+  TableExporter() = delete;
+
+  void beginRow();
+
+  void writeField(std::size_t col, const char *data, std::size_t len);
+
+  void endRow();
+
+  void writeCSVField(const char *data, std::size_t len);
+
+  void writeTSVField(const char *data, std::size_t len);
+
+  void writeJSONString(const char *data, std::size_t len);
+
+  OutputBuffer &d_out;
+  const Format d_format;
+  const std::vector<std::string> d_columnNames;
+  std::size_t d_numRows;
+};
+}
+
+#endif /*  __TABLEEXPORT_H_LOADED__ */
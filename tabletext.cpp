@@ -2,68 +2,615 @@
 #include "stringreg.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <stdexcept>
+#include <thread>
 
 using namespace cab;
 
+namespace {
+std::string
+limitMessage(LimitError::Limit limit, std::size_t value, std::size_t maximum)
+{
+  static const char *const names[] = { "Text size", "Row count", "Line width" };
+  return std::string(names[static_cast<int>(limit)]) + " " + std::to_string(value) +
+         " exceeds the limit of " + std::to_string(maximum);
+}
+}
+
+LimitError::LimitError(Limit limit, std::size_t value, std::size_t maximum)
+  : std::length_error(limitMessage(limit, value, maximum)),
+    d_limit(limit),
+    d_value(value),
+    d_maximum(maximum)
+{
+}
+
 TableText::TableText(const std::string &multilineText)
-  : d_text(multilineText),
-    d_numRows(0u)
+  : TableText(multilineText, Options())
 {
-  countSpaces();
 }
 
 TableText::TableText(const char *multilineText)
-  : d_text(multilineText),
-    d_numRows(0u)
+  : TableText(multilineText, Options())
+{
+}
+
+TableText::TableText(const std::string &multilineText, const Options &options)
+  : d_numRows(0u),
+    d_options(options)
+{
+  // check before copying, so a huge text is never copied
+  checkBytes(multilineText.size());
+  d_text.assign(multilineText);
+  countSpaces();
+}
+
+TableText::TableText(const char *multilineText, const Options &options)
+  : d_numRows(0u),
+    d_options(options)
 {
+  checkBytes(std::strlen(multilineText));
+  d_text.assign(multilineText);
   countSpaces();
 }
 
 namespace {
-/// short lines are treated like they are padded with spaces at the end
-void
-padShortLines(std::vector<int> &spaces, std::size_t curCol)
+/// return true for the second and later bytes of a UTF-8 sequence
+inline bool
+isContinuation(char ch)
+{
+  return 0x80 == (static_cast<unsigned char>(ch) & 0xc0);
+}
+
+/// return the column after a character that starts in column @p col
+inline std::size_t
+nextColumn(char ch, std::size_t col, std::size_t tabStop)
+{
+  if ('\t' == ch) {
+    return ((col / tabStop) + 1u) * tabStop;
+  }
+  return isContinuation(ch) ? col : (col + 1u);
+}
+
+/// return the CharClass of @p ch or -1 if it's in none of them
+inline int
+charClass(char ch)
 {
-  while (curCol < spaces.size()) {
-    ++spaces[curCol];
-    ++curCol;
+  const unsigned uch(static_cast<unsigned char>(ch));
+  if ((uch - '0') < 10u) {
+    return TableText::e_Digit;
+  }
+  if ((((uch | 0x20u) - 'a') < 26u) || (uch >= 0xc0u)) {
+    return TableText::e_Letter;
   }
+  if ('-' == uch) {
+    return TableText::e_Dash;
+  }
+  return ('/' == uch) ? TableText::e_Slash : -1;
 }
 }
 
 void
 TableText::countSpaces()
 {
-  std::size_t curCol(0u);
   d_spaceCounts.reserve(128u);
-  for(const char ch : d_text) { // iterate through whole string
-    if ('\n' == ch) {
-      padShortLines(d_spaceCounts, curCol);
-      // increment row count and reset for next line
+  if (0u == d_options.tabStop) {
+    d_options.tabStop = 1u;
+  }
+  d_plain = isPlainASCII(d_text.data(), d_text.size());
+  d_widthCounts.clear();
+  const char *const text(d_text.data());
+  const char *cur(text);
+  const char *const end(text + d_text.size());
+  while (cur < end) { // iterate through whole string
+    if (d_options.maxRows && (d_numRows >= d_options.maxRows)) {
+      throw LimitError(LimitError::Limit::Rows, d_numRows + 1u, d_options.maxRows);
+    }
+    const char *const next(static_cast<const char *>(std::memchr(cur, '\n', end - cur)));
+    const std::size_t len(static_cast<std::size_t>((next ? next : end) - cur));
+    // an outlier is counted like a blank line
+    const std::size_t width(countedWidth(cur, len));
+    if (width > d_spaceCounts.size()) {
+      // the padding of the rows so far is added below
+      resizeCounts(width, 0);
+    }
+    d_lineStarts.push_back(static_cast<std::size_t>(cur - text));
+    if (width) {
+      countLineSpaces(cur, len, 1);
+    }
+    // an unterminated last line isn't padded
+    if (next) {
+      if (width >= d_widthCounts.size()) {
+        d_widthCounts.resize(width + 1u, 0);
+      }
+      ++d_widthCounts[width];
+    }
+    ++d_numRows;
+    cur = (next ? (next + 1) : end);
+  }
+  // column i is padding for every line i or fewer columns wide
+  const std::size_t maxWidth(d_spaceCounts.size());
+  if (d_widthCounts.size() <= maxWidth) {
+    d_widthCounts.resize(maxWidth + 1u, 0);
+  }
+  int padding(0);
+  for(std::size_t col = 0u; col < maxWidth; ++col) {
+    padding += d_widthCounts[col];
+    d_spaceCounts[col] += padding;
+  }
+}
+
+void
+TableText::checkBytes(std::size_t numBytes) const
+{
+  if (d_options.maxBytes && (numBytes > d_options.maxBytes)) {
+    throw LimitError(LimitError::Limit::Bytes, numBytes, d_options.maxBytes);
+  }
+}
+
+bool
+TableText::isOutlier(std::size_t width) const noexcept
+{
+  return d_options.clipWideLines && d_options.maxWidth && (width > d_options.maxWidth);
+}
+
+std::size_t
+TableText::countedWidth(const char *line, std::size_t len) const
+{
+  const std::size_t width(displayWidth(line, len));
+  if (d_options.maxWidth && (width > d_options.maxWidth)) {
+    if (!d_options.clipWideLines) {
+      throw LimitError(LimitError::Limit::Width, width, d_options.maxWidth);
+    }
+    return 0u;
+  }
+  return width;
+}
+
+void
+TableText::addLineSpaces(const char *line, std::size_t len)
+{
+  const std::size_t width(countedWidth(line, len));
+  if (width > d_spaceCounts.size()) {
+    resizeCounts(width, static_cast<int>(d_numRows));
+  }
+  if (width) {
+    countLineSpaces(line, len, 1);
+  }
+  padLine(width, 1);
+  if (width >= d_widthCounts.size()) {
+    d_widthCounts.resize(width + 1u, 0);
+  }
+  ++d_widthCounts[width];
+}
+
+void
+TableText::removeLineSpaces(const char *line, std::size_t len)
+{
+  const std::size_t width(displayWidth(line, len));
+  if (isOutlier(width)) {
+    padLine(0u, -1);
+    --d_widthCounts[0];
+    return;
+  }
+  countLineSpaces(line, len, -1);
+  padLine(width, -1);
+  --d_widthCounts[width];
+}
+
+void
+TableText::countLineSpaces(const char *line, std::size_t len, int delta)
+{
+  if (d_plain) {
+    countPlainSpaces(line, len, delta);
+  }
+  else {
+    countDisplaySpaces(line, len, delta);
+  }
+}
+
+void
+TableText::padLine(std::size_t width, int delta)
+{
+  // short lines are treated like they are padded with spaces at the end
+  int *const counts(d_spaceCounts.data());
+  const std::size_t maxWidth(d_spaceCounts.size());
+  for(std::size_t col = width; col < maxWidth; ++col) {
+    counts[col] += delta;
+  }
+}
+
+void
+TableText::countPlainSpaces(const char *line, std::size_t len, int delta)
+{
+  int *const counts(d_spaceCounts.data());
+  if (d_options.profileColumns) {
+    int *const digits(d_charCounts[e_Digit].data());
+    int *const letters(d_charCounts[e_Letter].data());
+    int *const dashes(d_charCounts[e_Dash].data());
+    int *const slashes(d_charCounts[e_Slash].data());
+    for(std::size_t col = 0u; col < len; ++col) {
+      const unsigned ch(static_cast<unsigned char>(line[col]));
+      counts[col] += delta * (' ' == ch);
+      digits[col] += delta * ((ch - '0') < 10u);
+      letters[col] += delta * (((ch | 0x20u) - 'a') < 26u);
+      dashes[col] += delta * ('-' == ch);
+      slashes[col] += delta * ('/' == ch);
+    }
+  }
+  else {
+    for(std::size_t col = 0u; col < len; ++col) {
+      counts[col] += delta * (' ' == line[col]);
+    }
+  }
+}
+
+void
+TableText::resizeCounts(std::size_t width, int padding)
+{
+  d_spaceCounts.resize(width, padding);
+  if (d_options.profileColumns) {
+    for(auto &counts : d_charCounts) {
+      counts.resize(width, 0);
+    }
+  }
+}
+
+std::size_t
+TableText::displayWidth(const char *line, std::size_t len) const noexcept
+{
+  if (d_plain) {
+    return len;
+  }
+  std::size_t col(0u);
+  for(std::size_t i = 0u; i < len; ++i) {
+    col = nextColumn(line[i], col, d_options.tabStop);
+  }
+  return col;
+}
+
+void
+TableText::countDisplaySpaces(const char *line, std::size_t len, int delta)
+{
+  int *const counts(d_spaceCounts.data());
+  std::size_t col(0u);
+  for(std::size_t i = 0u; i < len; ++i) {
+    const std::size_t next(nextColumn(line[i], col, d_options.tabStop));
+    if (('\t' == line[i]) || (' ' == line[i])) {
+      // every column a tab covers is blank
+      for(; col < next; ++col) {
+        counts[col] += delta;
+      }
+    }
+    else if (d_options.profileColumns && (col < next)) {
+      const int cls(charClass(line[i]));
+      if (cls >= 0) {
+        d_charCounts[cls][col] += delta;
+      }
+    }
+    col = next;
+  }
+}
+
+std::size_t
+TableText::lineLength(std::size_t row) const noexcept
+{
+  const std::size_t end((row + 1u) < d_numRows ? (d_lineStarts[row + 1u] - 1u) :
+                        (d_text.empty() || ('\n' != d_text.back()) ?
+                         d_text.size() : (d_text.size() - 1u)));
+  return end - d_lineStarts[row];
+}
+
+namespace {
+/**
+ * @brief a run of rows of the edited text: @c count rows of the text
+ *        before the edits starting at @c first, or the one line of
+ *        @c edit
+ */
+struct EditPiece {
+  std::size_t first;
+  std::size_t count;
+  const TableText::LineEdit *edit;
+};
+
+/**
+ * @brief return the index of the piece that starts at row @p row,
+ *        splitting a run of rows if it starts inside one
+ */
+std::size_t
+splitPieces(std::vector<EditPiece> &pieces, std::size_t row)
+{
+  std::size_t start(0u);
+  for(std::size_t i = 0u; i < pieces.size(); ++i) {
+    if (row == start) {
+      return i;
+    }
+    if (row < (start + pieces[i].count)) {
+      const std::size_t head(row - start);
+      pieces.insert(pieces.begin() + i + 1u,
+                    EditPiece{ pieces[i].first + head, pieces[i].count - head, nullptr });
+      pieces[i].count = head;
+      return i + 1u;
+    }
+    start += pieces[i].count;
+  }
+  return pieces.size();
+}
+}
+
+void
+TableText::applyEdits(const EditList &edits)
+{
+  if (edits.empty()) {
+    return;
+  }
+  // Describe the edited text as runs of the current rows and edited
+  // lines, and check every edit before anything changes. This costs
+  // time in proportion to the number of edits, not the rows.
+  std::vector<EditPiece> pieces;
+  if (d_numRows) {
+    pieces.push_back(EditPiece{ 0u, d_numRows, nullptr });
+  }
+  std::size_t numRows(d_numRows);
+  // every line is terminated after editing
+  std::size_t numBytes(d_text.size() + ((d_text.empty() || ('\n' == d_text.back())) ? 0u : 1u));
+  const bool wasPlain(d_plain);
+  try {
+    for(const LineEdit &edit : edits) {
+      if (std::string::npos != edit.text.find('\n')) {
+        throw std::invalid_argument("A line edit can't contain a newline");
+      }
+      const bool inserting(LineEdit::Kind::Insert == edit.kind);
+      if (inserting ? (edit.row > numRows) : (edit.row >= numRows)) {
+        throw std::out_of_range("Line edit refers to a row that doesn't exist");
+      }
+      if (inserting && d_options.maxRows && (numRows >= d_options.maxRows)) {
+        throw LimitError(LimitError::Limit::Rows, numRows + 1u, d_options.maxRows);
+      }
+      const std::size_t index(splitPieces(pieces, edit.row));
+      // including the newlines
+      std::size_t oldLength(0u);
+      if (!inserting) {
+        const EditPiece &piece(pieces[index]);
+        oldLength = (piece.edit ? piece.edit->text.size() : lineLength(piece.first)) + 1u;
+        if (piece.count > 1u) {
+          splitPieces(pieces, edit.row + 1u);
+        }
+      }
+      const std::size_t newLength(LineEdit::Kind::Remove == edit.kind ? 0u :
+                                  (edit.text.size() + 1u));
+      checkBytes(numBytes + newLength - oldLength);
+      numBytes = numBytes + newLength - oldLength;
+      if (newLength) {
+        if (d_plain && !isPlainASCII(edit.text.data(), edit.text.size())) {
+          // the slow path must be used from now on
+          d_plain = false;
+        }
+        countedWidth(edit.text.data(), edit.text.size());
+      }
+      if (inserting) {
+        pieces.insert(pieces.begin() + index, EditPiece{ 0u, 1u, &edit });
+        ++numRows;
+      }
+      else if (newLength) {
+        pieces[index] = EditPiece{ 0u, 1u, &edit };
+      }
+      else {
+        pieces.erase(pieces.begin() + index);
+        --numRows;
+      }
+    }
+  }
+  catch (...) {
+    d_plain = wasPlain;
+    throw;
+  }
+
+  // the edited text is terminated, so an unterminated last line is
+  // padded from now on
+  if (d_numRows && ('\n' != d_text.back())) {
+    const std::size_t last(d_numRows - 1u);
+    const std::size_t width(displayWidth(d_text.data() + d_lineStarts[last], lineLength(last)));
+    const std::size_t counted(isOutlier(width) ? 0u : width);
+    padLine(counted, 1);
+    if (counted >= d_widthCounts.size()) {
+      d_widthCounts.resize(counted + 1u, 0);
+    }
+    ++d_widthCounts[counted];
+  }
+
+  // remove the rows that are gone from the counts
+  std::size_t numRemoved(0u), nextRow(0u);
+  const auto removeRows = [&](std::size_t end) {
+    for(; nextRow < end; ++nextRow) {
+      removeLineSpaces(d_text.data() + d_lineStarts[nextRow], lineLength(nextRow));
+      ++numRemoved;
+    }
+  };
+  for(const EditPiece &piece : pieces) {
+    if (!piece.edit) {
+      removeRows(piece.first);
+      nextRow = piece.first + piece.count;
+    }
+  }
+  removeRows(d_numRows);
+
+  // merge the runs of rows and the edited lines into the new text
+  std::string text;
+  text.reserve(numBytes);
+  std::vector<std::size_t> lineStarts;
+  lineStarts.reserve(numRows);
+  for(const EditPiece &piece : pieces) {
+    if (piece.edit) {
+      lineStarts.push_back(text.size());
+      text.append(piece.edit->text);
+      text.push_back('\n');
+      continue;
+    }
+    const std::size_t last(piece.first + piece.count - 1u);
+    const std::size_t begin(d_lineStarts[piece.first]);
+    const std::size_t end(d_lineStarts[last] + lineLength(last));
+    for(std::size_t row = piece.first; row <= last; ++row) {
+      lineStarts.push_back(d_lineStarts[row] - begin + text.size());
+    }
+    text.append(d_text, begin, end - begin);
+    text.push_back('\n');
+  }
+  d_text.swap(text);
+  d_lineStarts.swap(lineStarts);
+  d_numRows -= numRemoved;
+  for(const EditPiece &piece : pieces) {
+    if (piece.edit) {
+      addLineSpaces(piece.edit->text.data(), piece.edit->text.size());
       ++d_numRows;
-      curCol = 0u;
     }
-    else {
-      if (curCol >= d_spaceCounts.size()) {
-        d_spaceCounts.resize(curCol+1, d_numRows);
+  }
+
+  // if the widest line got shorter, drop the columns of padding
+  while ((d_widthCounts.size() > 1u) && (0 == d_widthCounts.back())) {
+    d_widthCounts.pop_back();
+  }
+  const std::size_t width(d_widthCounts.empty() ? 0u : (d_widthCounts.size() - 1u));
+  if (width < d_spaceCounts.size()) {
+    d_spaceCounts.resize(width);
+    if (d_options.profileColumns) {
+      for(auto &counts : d_charCounts) {
+        counts.resize(width);
+      }
+    }
+  }
+}
+
+bool
+TableText::retabulate(const EditList     &edits,
+                      unsigned            minCols,
+                      ColumnLayout       &layout,
+                      RowAndColumnList   &rows)
+{
+  const bool rowsMatch(rows.size() == d_numRows);
+  applyEdits(edits);
+  ColumnLayout newLayout(findLayout(minCols));
+  if (rowsMatch && (newLayout == layout)) {
+    SpanRow spans;
+    spans.reserve(layout.size());
+    for(const LineEdit &edit : edits) {
+      if (LineEdit::Kind::Remove == edit.kind) {
+        rows.erase(rows.begin() + edit.row);
       }
-      if (' ' == ch) {
-        ++d_spaceCounts[curCol];
+      else {
+        spansFromLine(layout, edit.text.data(), edit.text.size(), spans);
+        std::vector<std::string> fields;
+        fields.reserve(spans.size());
+        for(const FieldSpan &field : spans) {
+          fields.emplace_back(field.data, field.length);
+        }
+        if (LineEdit::Kind::Insert == edit.kind) {
+          rows.insert(rows.begin() + edit.row, std::move(fields));
+        }
+        else {
+          rows.at(edit.row) = std::move(fields);
+        }
       }
-      ++curCol;
     }
+    return true;
   }
-  if (!d_text.empty() && ('\n' != d_text.back())) {
-    ++d_numRows;
+  layout = std::move(newLayout);
+  rows = copyColumns(layout);
+  return false;
+}
+
+const std::vector<int> &
+TableText::getCharCounts(CharClass cls) const
+{
+  if (!d_options.profileColumns) {
+    throw std::logic_error("Column profiles were not requested");
+  }
+  return d_charCounts[cls];
+}
+
+TableText::ColumnProfile
+TableText::getProfile(const ColumnRange &range) const
+{
+  if (!d_options.profileColumns) {
+    throw std::logic_error("Column profiles were not requested");
+  }
+  ColumnProfile result{ 0u, 0u, 0u, 0u, 0u, 0u };
+  const std::size_t end(std::min(range.end, d_spaceCounts.size()));
+  for(std::size_t col = range.begin; col < end; ++col) {
+    result.spaces += d_spaceCounts[col];
+    result.digits += d_charCounts[e_Digit][col];
+    result.letters += d_charCounts[e_Letter][col];
+    result.dashes += d_charCounts[e_Dash][col];
+    result.slashes += d_charCounts[e_Slash][col];
   }
+  const std::size_t total(d_numRows * ((end > range.begin) ? (end - range.begin) : 0u));
+  result.others = total - result.spaces - result.digits - result.letters -
+                  result.dashes - result.slashes;
+  return result;
+}
+
+std::vector<TableText::ColumnType>
+TableText::inferColumnTypes(const ColumnLayout &layout) const
+{
+  std::vector<ColumnType> result;
+  result.reserve(layout.size());
+  for(const ColumnRange &cr : layout) {
+    const ColumnProfile profile(getProfile(cr));
+    const std::size_t nonSpace(profile.digits + profile.letters + profile.dashes +
+                               profile.slashes + profile.others);
+    ColumnType type(ColumnType::Mixed);
+    if (0u == nonSpace) {
+      type = ColumnType::Empty;
+    }
+    else if (nonSpace == profile.digits) {
+      type = ColumnType::Numeric;
+      if (!result.empty() && (ColumnType::Date == result.back())) {
+        // HHMM: every row has a digit in the same four columns
+        const std::size_t end(std::min(cr.end, d_spaceCounts.size()));
+        std::size_t fullColumns(0u);
+        for(std::size_t col = cr.begin; col < end; ++col) {
+          fullColumns += (static_cast<std::size_t>(d_charCounts[e_Digit][col]) == d_numRows);
+        }
+        if ((4u == fullColumns) && (profile.digits == (4u * d_numRows))) {
+          type = ColumnType::Time;
+        }
+      }
+    }
+    else if ((nonSpace == (profile.digits + profile.dashes)) && profile.digits) {
+      type = ColumnType::Date;
+    }
+    else if (profile.letters && profile.digits &&
+             (nonSpace == (profile.letters + profile.digits + profile.slashes))) {
+      type = ColumnType::Callsign;
+    }
+    else if (profile.letters && !profile.digits && !profile.others) {
+      type = ColumnType::Text;
+    }
+    result.push_back(type);
+  }
+  return result;
+}
+
+std::vector<std::size_t>
+TableText::getOutlierRows() const
+{
+  std::vector<std::size_t> result;
+  if (d_options.maxWidth && d_options.clipWideLines) {
+    for(std::size_t row = 0u; row < d_numRows; ++row) {
+      if (isOutlier(displayWidth(d_text.data() + d_lineStarts[row], lineLength(row)))) {
+        result.push_back(row);
+      }
+    }
+  }
+  return result;
 }
 
 std::vector<int>
-TableText::uniqueSpaceCounts() const
+TableText::uniqueSpaceCounts(const std::vector<int> &spaceCounts)
 {
-  std::vector<int> spaces(d_spaceCounts);
+  std::vector<int> spaces(spaceCounts);
   spaces.push_back(0);
   std::sort(spaces.begin(), spaces.end());
   auto it = std::unique(spaces.begin(), spaces.end());
@@ -71,35 +618,114 @@ TableText::uniqueSpaceCounts() const
   return spaces;
 }
 
-TableText::RowAndColumnList
-TableText::tabulate(unsigned minCols) const
+TableText::ColumnLayout
+TableText::findLayout(unsigned minCols) const
+{
+  return layoutFromCounts(d_spaceCounts, d_numRows, minCols);
+}
+
+TableText::ColumnLayout
+TableText::layoutFromCounts(const std::vector<int> &spaceCounts,
+                            std::size_t             numRows,
+                            unsigned                minCols)
 {
-  std::vector<int> spaces(uniqueSpaceCounts());
-  std::vector<ColumnRange> columns;
+  std::vector<int> spaces(uniqueSpaceCounts(spaceCounts));
+  ColumnLayout columns;
   columns.reserve(minCols);
   for(auto rit=spaces.rbegin(); rit != spaces.rend(); ++rit) {
     const int minSpaceForColEnd(*rit);
-    findColumns(minSpaceForColEnd, columns);
+    findColumns(spaceCounts, static_cast<int>(numRows), minSpaceForColEnd, columns);
     if (columns.size() >= minCols) {
-      return copyColumns(columns);
+      return columns;
     }
   }
   throw std::out_of_range("Unable to find enough columns");
 }
 
+TableText::RowAndColumnList
+TableText::tabulate(unsigned minCols) const
+{
+  return copyColumns(findLayout(minCols));
+}
+
+TableText::RowAndColumnList
+TableText::tabulate(const ColumnLayout &layout) const
+{
+  return copyColumns(layout);
+}
+
 void
-TableText::findColumns(const int                minSpaceForColEnd,
-                       std::vector<ColumnRange> &table) const
+TableText::tabulate(unsigned minCols, RowAndColumnList &result) const
 {
-  const std::size_t maxWidth(d_spaceCounts.size());
-  const int numLines(static_cast<int>(d_numRows));
+  copyColumns(findLayout(minCols), result);
+}
+
+void
+TableText::tabulate(const ColumnLayout &layout, RowAndColumnList &result) const
+{
+  copyColumns(layout, result);
+}
+
+void
+TableText::clearCounts() noexcept
+{
+  d_lineStarts.clear();
+  d_spaceCounts.clear();
+  d_widthCounts.clear();
+  for(auto &counts : d_charCounts) {
+    counts.clear();
+  }
+  d_numRows = 0u;
+}
+
+void
+TableText::reset(const std::string &multilineText)
+{
+  clearCounts();
+  d_text.clear();
+  checkBytes(multilineText.size());
+  d_text.assign(multilineText);
+  try {
+    countSpaces();
+  }
+  catch (const LimitError &) {
+    clearCounts();
+    d_text.clear();
+    throw;
+  }
+}
+
+void
+TableText::reset(const char *multilineText)
+{
+  clearCounts();
+  d_text.clear();
+  checkBytes(std::strlen(multilineText));
+  d_text.assign(multilineText);
+  try {
+    countSpaces();
+  }
+  catch (const LimitError &) {
+    clearCounts();
+    d_text.clear();
+    throw;
+  }
+}
+
+void
+TableText::findColumns(const std::vector<int>   &spaceCounts,
+                       const int                 numLines,
+                       const int                 minSpaceForColEnd,
+                       std::vector<ColumnRange> &table)
+{
+  const std::size_t maxWidth(spaceCounts.size());
   const int startColumnThreshold((3*numLines)/4);
   table.clear();
   std::size_t pos=0;
   while (pos < maxWidth) {
     ColumnRange cr;
     // find start
-    while ((pos < maxWidth) && (d_spaceCounts[pos] >= numLines)) {
+    while ((pos < maxWidth) && (spaceCounts[pos] >= numLines)) {
       ++pos;
     }
     if (pos < maxWidth) {
@@ -107,26 +733,26 @@ TableText::findColumns(const int                minSpaceForColEnd,
       cr.begin = pos;
       // find end
       while (pos < maxWidth) {
-        for(++pos; (pos < maxWidth) && (d_spaceCounts[pos] < minSpaceForColEnd); ++pos) {
-          if (d_spaceCounts[pos] > maxSpaces) {
-            maxSpaces = d_spaceCounts[pos];
+        for(++pos; (pos < maxWidth) && (spaceCounts[pos] < minSpaceForColEnd); ++pos) {
+          if (spaceCounts[pos] > maxSpaces) {
+            maxSpaces = spaceCounts[pos];
           }
         }
         if ((pos + 1) < maxWidth) {
-          if ((d_spaceCounts[pos] >= numLines) && (d_spaceCounts[pos+1] >= numLines)) {
+          if ((spaceCounts[pos] >= numLines) && (spaceCounts[pos+1] >= numLines)) {
             // two consecutive columns of all spaces => column must be done
             break;
           }
           ++pos;
-          if (d_spaceCounts[pos] < maxSpaces) {
+          if (spaceCounts[pos] < maxSpaces) {
             // pos + 1 looks like the start of another column
             break;
           }
         }
         else {
           if ((pos < maxWidth) &&
-              ((d_spaceCounts[pos] <= startColumnThreshold)  ||
-               (d_spaceCounts[pos] == numLines))) {
+              ((spaceCounts[pos] <= startColumnThreshold)  ||
+               (spaceCounts[pos] == numLines))) {
             break;
             ++pos;
           }
@@ -138,22 +764,59 @@ TableText::findColumns(const int                minSpaceForColEnd,
   }
 }
 
-TableText::RowAndColumnList::value_type
-TableText::fieldsFromLine(const std::vector<ColumnRange> &table,
-                          const std::string &line) const
+namespace {
+inline bool
+isTrimSpace(char ch)
 {
-  std::vector<std::string> columnList;
-  columnList.reserve(table.size());
-  for(const ColumnRange &cr : table) {
-    if (cr.begin < line.size()) {
-      std::string newCol(cab::trim(line.substr(cr.begin, cr.end-cr.begin)));
-      columnList.push_back(newCol);
+  // the same characters that cab::trim removes
+  return (' ' == ch) || (('\t' <= ch) && (ch <= '\r'));
+}
+}
+
+void
+TableText::spansFromLine(const std::vector<ColumnRange> &table,
+                         const char *line, std::size_t len,
+                         SpanRow &row) const
+{
+  row.clear();
+  if (!d_plain) {
+    // convert columns into character positions one column at a time
+    std::size_t pos(0u), col(0u);
+    for(const ColumnRange &cr : table) {
+      while ((pos < len) && ((col < cr.begin) || isContinuation(line[pos]))) {
+        col = nextColumn(line[pos++], col, d_options.tabStop);
+      }
+      const char *first(line + pos);
+      while ((pos < len) && ((col < cr.end) || isContinuation(line[pos]))) {
+        col = nextColumn(line[pos++], col, d_options.tabStop);
+      }
+      const char *last(line + pos);
+      while ((first < last) && isTrimSpace(*first)) {
+        ++first;
+      }
+      while ((first < last) && isTrimSpace(*(last-1))) {
+        --last;
+      }
+      row.push_back(FieldSpan{ first, static_cast<std::size_t>(last - first) });
     }
-    else {
-      columnList.push_back(std::string());
+    return;
+  }
+  for(const ColumnRange &cr : table) {
+    FieldSpan field{ line, 0u };
+    if (cr.begin < len) {
+      const char *first(line + cr.begin);
+      const char *last(line + std::min(cr.end, len));
+      while ((first < last) && isTrimSpace(*first)) {
+        ++first;
+      }
+      while ((first < last) && isTrimSpace(*(last-1))) {
+        --last;
+      }
+      field.data = first;
+      field.length = static_cast<std::size_t>(last - first);
     }
+    row.push_back(field);
   }
-  return columnList;
 }
 
 TableText::RowAndColumnList
@@ -161,13 +824,391 @@ TableText::copyColumns(const std::vector<ColumnRange> &table) const
 {
   RowAndColumnList result;
   result.reserve(d_numRows);
-  std::size_t cur(0u), next;
-  while (std::string::npos != (next = d_text.find('\n', cur))) {
-    result.push_back(std::move(fieldsFromLine(table, d_text.substr(cur, next-cur))));
-    cur = next+1;
+  forEachRow(table, [&result](const SpanRow &row) {
+    result.emplace_back();
+    std::vector<std::string> &columnList(result.back());
+    columnList.reserve(row.size());
+    for(const FieldSpan &field : row) {
+      columnList.emplace_back(field.data, field.length);
+    }
+  });
+  return result;
+}
+
+void
+TableText::copyColumns(const std::vector<ColumnRange> &table,
+                       RowAndColumnList &result) const
+{
+  result.resize(d_numRows);
+  std::size_t rowNum(0u);
+  forEachRow(table, [&result, &rowNum](const SpanRow &row) {
+    std::vector<std::string> &columnList(result[rowNum++]);
+    columnList.resize(row.size());
+    for(std::size_t col = 0u; col < row.size(); ++col) {
+      columnList[col].assign(row[col].data, row[col].length);
+    }
+  });
+}
+
+struct TableText::SpaceHistogram {
+  /// spaces per column, including the padding once finish() is called
+  std::vector<int> spaces;
+  /// widths[w] is the number of rows w columns wide until finish()
+  std::vector<int> widths;
+  int rows = 0;
+
+  /// add the padding of the short rows
+  void finish()
+  {
+    int padding(0);
+    for(std::size_t col = 0u; col < spaces.size(); ++col) {
+      padding += widths[col];
+      spaces[col] += padding;
+    }
+    widths.clear();
   }
-  if (cur < d_text.size()) {
-    result.push_back(std::move(fieldsFromLine(table, d_text.substr(cur))));
+
+  /// every row is blank past the widest one
+  int at(std::size_t col) const noexcept
+  {
+    return (col < spaces.size()) ? spaces[col] : rows;
+  }
+
+  /// the columns blank in every row here and filled in 3/4 of the rows of @p other
+  std::vector<std::size_t> gapsFilledIn(const SpaceHistogram &other) const
+  {
+    std::vector<std::size_t> result;
+    for(std::size_t col = 0u; col < other.spaces.size(); ++col) {
+      if ((at(col) >= rows) && ((4 * other.spaces[col]) <= other.rows)) {
+        result.push_back(col);
+      }
+    }
+    return result;
+  }
+
+  bool conflictsWith(const SpaceHistogram &other) const
+  {
+    return !gapsFilledIn(other).empty() || !other.gapsFilledIn(*this).empty();
+  }
+
+  /// add the finished counts of @p other
+  void merge(const SpaceHistogram &other)
+  {
+    const std::size_t width(std::max(spaces.size(), other.spaces.size()));
+    spaces.resize(width, rows);
+    for(std::size_t col = 0u; col < width; ++col) {
+      spaces[col] += other.at(col);
+    }
+    rows += other.rows;
+  }
+};
+
+void
+TableText::countRows(std::size_t first, std::size_t last, SpaceHistogram &hist) const
+{
+  for(std::size_t row = first; row < last; ++row) {
+    const char *const line(d_text.data() + d_lineStarts[row]);
+    const std::size_t len(lineLength(row));
+    std::size_t width(displayWidth(line, len));
+    if (isOutlier(width)) {
+      width = 0u;
+    }
+    if (width > hist.spaces.size()) {
+      hist.spaces.resize(width, 0);
+    }
+    if (d_plain) {
+      for(std::size_t col = 0u; col < width; ++col) {
+        hist.spaces[col] += (' ' == line[col]);
+      }
+    }
+    else if (width) {
+      std::size_t col(0u);
+      for(std::size_t i = 0u; i < len; ++i) {
+        const std::size_t next(nextColumn(line[i], col, d_options.tabStop));
+        if (('\t' == line[i]) || (' ' == line[i])) {
+          for(; col < next; ++col) {
+            ++hist.spaces[col];
+          }
+        }
+        col = next;
+      }
+    }
+    if (width >= hist.widths.size()) {
+      hist.widths.resize(width + 1u, 0);
+    }
+    // like countSpaces(), an unterminated last line isn't padded
+    hist.widths[width] += ((line + len) != (d_text.data() + d_text.size()));
+    ++hist.rows;
+  }
+  hist.widths.resize(hist.spaces.size() + 1u, 0);
+  hist.finish();
+}
+
+bool
+TableText::isBlankAt(std::size_t row, std::size_t col) const
+{
+  const char *const line(d_text.data() + d_lineStarts[row]);
+  const std::size_t len(lineLength(row));
+  if (d_plain) {
+    return (col >= len) || (' ' == line[col]) || isOutlier(len);
+  }
+  if (isOutlier(displayWidth(line, len))) {
+    return true;
+  }
+  std::size_t pos(0u);
+  for(std::size_t i = 0u; i < len; ++i) {
+    const std::size_t next(nextColumn(line[i], pos, d_options.tabStop));
+    if (col < next) {
+      return ('\t' == line[i]) || (' ' == line[i]);
+    }
+    pos = next;
+  }
+  return true;
+}
+
+bool
+TableText::fitsGaps(std::size_t row, const std::vector<std::size_t> &gaps) const
+{
+  for(const std::size_t col : gaps) {
+    if (!isBlankAt(row, col)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TableText::SegmentList
+TableText::findSegments(unsigned minCols, std::size_t window) const
+{
+  SegmentList result;
+  if (0u == d_numRows) {
+    return result;
+  }
+  window = std::max(window, std::size_t(1u));
+  const std::size_t numWindows((d_numRows + window - 1u) / window);
+  std::vector<SpaceHistogram> windows(numWindows);
+  for(std::size_t w = 0u; w < numWindows; ++w) {
+    countRows(w * window, std::min((w + 1u) * window, d_numRows), windows[w]);
+  }
+
+  // look for a split between each window and the next, or the one after
+  // that when the change is in the middle of the window between them
+  std::vector<std::size_t> starts(1u, 0u);
+  for(std::size_t w = 0u; (w + 1u) < numWindows; ++w) {
+    std::size_t right(w + 1u);
+    std::vector<std::size_t> leftGaps(windows[w].gapsFilledIn(windows[right]));
+    std::vector<std::size_t> rightGaps(windows[right].gapsFilledIn(windows[w]));
+    if (leftGaps.empty() && rightGaps.empty() && ((w + 2u) < numWindows)) {
+      right = w + 2u;
+      leftGaps = windows[w].gapsFilledIn(windows[right]);
+      rightGaps = windows[right].gapsFilledIn(windows[w]);
+    }
+    if (leftGaps.empty() && rightGaps.empty()) {
+      continue;
+    }
+    // each row votes for the side whose gaps it leaves blank
+    const std::size_t first(w * window);
+    const std::size_t last(std::min((right + 1u) * window, d_numRows));
+    std::size_t split(first);
+    long votes(0), best(0);
+    for(std::size_t row = first; row < last; ++row) {
+      if (!leftGaps.empty()) {
+        votes += fitsGaps(row, leftGaps) ? 1 : -1;
+      }
+      if (!rightGaps.empty()) {
+        votes += fitsGaps(row, rightGaps) ? -1 : 1;
+      }
+      if (votes > best) {
+        best = votes;
+        split = row + 1u;
+      }
+    }
+    if ((split > starts.back()) && (split < d_numRows)) {
+      starts.push_back(split);
+    }
+  }
+
+  // join the neighbors that don't conflict as a whole
+  std::vector<SpaceHistogram> hists;
+  starts.push_back(d_numRows);
+  for(std::size_t i = 0u; (i + 1u) < starts.size(); ++i) {
+    SpaceHistogram hist;
+    countRows(starts[i], starts[i + 1u], hist);
+    if (!hists.empty() && !hists.back().conflictsWith(hist)) {
+      hists.back().merge(hist);
+      result.back().numRows += hist.rows;
+    }
+    else {
+      hists.push_back(std::move(hist));
+      result.push_back(Segment{ starts[i], starts[i + 1u] - starts[i], ColumnLayout() });
+    }
+  }
+  for(std::size_t i = 0u; i < result.size(); ++i) {
+    result[i].layout = layoutFromCounts(hists[i].spaces, result[i].numRows, minCols);
+  }
+  return result;
+}
+
+TableText::SegmentedRows
+TableText::tabulateSegments(unsigned minCols, unsigned threads) const
+{
+  SegmentedRows result;
+  result.segments = findSegments(minCols);
+  result.rows.resize(d_numRows);
+  result.rowSegments.resize(d_numRows);
+  // every segment fills its own rows, so the threads don't overlap
+  std::atomic<std::size_t> nextSegment(0u);
+  auto worker = [this, &result, &nextSegment]() {
+    SpanRow spans;
+    for(std::size_t seg = nextSegment++; seg < result.segments.size(); seg = nextSegment++) {
+      const Segment &segment(result.segments[seg]);
+      for(std::size_t row = segment.firstRow; row < (segment.firstRow + segment.numRows); ++row) {
+        spansFromLine(segment.layout, d_text.data() + d_lineStarts[row], lineLength(row), spans);
+        std::vector<std::string> &fields(result.rows[row]);
+        fields.reserve(spans.size());
+        for(const FieldSpan &field : spans) {
+          fields.emplace_back(field.data, field.length);
+        }
+        result.rowSegments[row] = seg;
+      }
+    }
+  };
+  const std::size_t numThreads(std::min<std::size_t>(std::max(threads, 1u),
+                               result.segments.size()));
+  std::vector<std::thread> helpers;
+  for(std::size_t i = 1u; i < numThreads; ++i) {
+    helpers.emplace_back(worker);
+  }
+  worker();
+  for(std::thread &helper : helpers) {
+    helper.join();
   }
   return result;
 }
+
+void
+TableText::markFilled(std::size_t row, std::vector<unsigned char> &filled) const
+{
+  std::fill(filled.begin(), filled.end(), static_cast<unsigned char>(0u));
+  const char *const line(d_text.data() + d_lineStarts[row]);
+  const std::size_t len(lineLength(row));
+  if (isOutlier(displayWidth(line, len))) {
+    // an outlier is counted like a blank line
+    return;
+  }
+  const std::size_t width(filled.size());
+  if (d_plain) {
+    for(std::size_t col = 0u; col < std::min(len, width); ++col) {
+      filled[col] = (' ' != line[col]);
+    }
+    return;
+  }
+  std::size_t col(0u);
+  for(std::size_t i = 0u; i < len; ++i) {
+    const std::size_t next(nextColumn(line[i], col, d_options.tabStop));
+    if (('\t' != line[i]) && (' ' != line[i])) {
+      for(std::size_t c = col; (c < next) && (c < width); ++c) {
+        filled[c] = 1u;
+      }
+    }
+    col = next;
+  }
+}
+
+TableText::CandidateList
+TableText::rankLayouts(unsigned minCols) const
+{
+  CandidateList result;
+  ColumnLayout columns;
+  const std::vector<int> spaces(uniqueSpaceCounts(d_spaceCounts));
+  for(auto rit = spaces.rbegin(); rit != spaces.rend(); ++rit) {
+    findColumns(d_spaceCounts, static_cast<int>(d_numRows), *rit, columns);
+    if ((columns.size() >= minCols) &&
+        std::none_of(result.begin(), result.end(), [&columns](const LayoutCandidate &c) {
+          return c.layout == columns;
+        })) {
+      result.push_back(LayoutCandidate{ columns, *rit, 0.0, 0.0, 0.0, 0.0 });
+    }
+  }
+  if (result.empty()) {
+    throw std::out_of_range("Unable to find enough columns");
+  }
+
+  // the candidates share most of their columns, so each distinct
+  // column is measured once per row
+  const auto before = [](const ColumnRange &a, const ColumnRange &b) {
+    return (a.begin < b.begin) || ((a.begin == b.begin) && (a.end < b.end));
+  };
+  ColumnLayout ranges;
+  for(const LayoutCandidate &candidate : result) {
+    ranges.insert(ranges.end(), candidate.layout.begin(), candidate.layout.end());
+  }
+  std::sort(ranges.begin(), ranges.end(), before);
+  ranges.erase(std::unique(ranges.begin(), ranges.end()), ranges.end());
+
+  const std::size_t width(d_spaceCounts.size());
+  const int mostlyBlank((3*static_cast<int>(d_numRows))/4);
+  std::vector<std::size_t> straddles(ranges.size(), 0u), empties(ranges.size(), 0u),
+      merges(ranges.size(), 0u);
+  std::vector<unsigned char> filled(width);
+  // nextFilled[c] is the first filled column at or after c, and
+  // lastFilled[c + 1] the last one before c + 1 (or width if none)
+  std::vector<std::size_t> nextFilled(width + 1u), lastFilled(width + 1u);
+  // gaps[c] counts the columns before c that are blank here and in 3/4 of the rows
+  std::vector<std::size_t> gaps(width + 1u);
+  for(std::size_t row = 0u; row < d_numRows; ++row) {
+    markFilled(row, filled);
+    nextFilled[width] = width;
+    for(std::size_t col = width; col > 0u; --col) {
+      nextFilled[col - 1u] = filled[col - 1u] ? (col - 1u) : nextFilled[col];
+    }
+    lastFilled[0] = width;
+    gaps[0] = 0u;
+    for(std::size_t col = 0u; col < width; ++col) {
+      lastFilled[col + 1u] = filled[col] ? col : lastFilled[col];
+      gaps[col + 1u] = gaps[col] + (!filled[col] && (d_spaceCounts[col] >= mostlyBlank));
+    }
+    for(std::size_t i = 0u; i < ranges.size(); ++i) {
+      const std::size_t begin(std::min(ranges[i].begin, width));
+      const std::size_t end(std::min(ranges[i].end, width));
+      const std::size_t first(nextFilled[begin]);
+      if (first >= end) {
+        ++empties[i];
+        continue;
+      }
+      const std::size_t last(lastFilled[end]);
+      straddles[i] += ((begin > 0u) && filled[begin - 1u] && filled[begin]) ||
+                      ((end < width) && filled[end - 1u] && filled[end]);
+      merges[i] += (gaps[last] > gaps[first]);
+    }
+  }
+
+  for(LayoutCandidate &candidate : result) {
+    std::size_t numStraddles(0u), numEmpties(0u), numMerges(0u);
+    for(const ColumnRange &cr : candidate.layout) {
+      const std::size_t i(std::lower_bound(ranges.begin(), ranges.end(), cr, before) -
+                          ranges.begin());
+      numStraddles += straddles[i];
+      numEmpties += empties[i];
+      numMerges += merges[i];
+    }
+    const double cells(static_cast<double>(d_numRows * candidate.layout.size()));
+    if (cells > 0.0) {
+      candidate.straddles = numStraddles / cells;
+      candidate.empties = numEmpties / cells;
+      candidate.merges = numMerges / cells;
+    }
+    candidate.score = candidate.straddles + candidate.empties + candidate.merges;
+  }
+  std::stable_sort(result.begin(), result.end(),
+  [](const LayoutCandidate &a, const LayoutCandidate &b) {
+    return a.score < b.score;
+  });
+  return result;
+}
+
+TableText::ColumnLayout
+TableText::findBestLayout(unsigned minCols) const
+{
+  return rankLayouts(minCols).front().layout;
+}
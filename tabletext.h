@@ -37,24 +37,89 @@
  */
 #ifndef __TABLETEXT_H_LOADED__
 #define __TABLETEXT_H_LOADED__
+#include <cstring>
+#include <stdexcept>
 #include <vector>
 #include <string>
 
 namespace cab {
 
+/**
+ * @brief Thrown when a text exceeds one of the limits in
+ *        TableText::Options
+ */
+class LimitError : public std::length_error {
+public:
+  enum class Limit {
+    Bytes,                      ///< TableText::Options::maxBytes
+    Rows,                       ///< TableText::Options::maxRows
+    Width                       ///< TableText::Options::maxWidth
+  };
+
+  LimitError(Limit limit, std::size_t value, std::size_t maximum);
+
+  /// which limit was exceeded
+  Limit which() const noexcept
+  {
+    return d_limit;
+  }
+
+  /// the size that exceeded the limit (for Rows, the first row too many)
+  std::size_t value() const noexcept
+  {
+    return d_value;
+  }
+
+  /// the limit that was exceeded
+  std::size_t maximum() const noexcept
+  {
+    return d_maximum;
+  }
+private:
+  Limit d_limit;
+  std::size_t d_value;
+  std::size_t d_maximum;
+};
+
 class TableText {
 public:
+  /**
+   * @brief Settings that control how the text is interpreted
+   */
+  struct Options {
+    /// horizontal tabs advance to the next multiple of this many columns
+    unsigned tabStop = 8u;
+    /**
+     * when true, digits, letters, dashes and slashes are counted per
+     * column while the spaces are counted (see inferColumnTypes)
+     */
+    bool profileColumns = false;
+    /// the most bytes of text accepted (0 for no limit)
+    std::size_t maxBytes = 0u;
+    /// the most lines accepted (0 for no limit)
+    std::size_t maxRows = 0u;
+    /// the widest line accepted in columns (0 for no limit)
+    std::size_t maxWidth = 0u;
+    /**
+     * when true, lines wider than maxWidth are outliers instead of
+     * errors. An outlier is counted like a blank line, so one huge
+     * line can't widen the counts for every row. It is still split
+     * into fields by the layout of the other rows, and its text past
+     * the last column is dropped.
+     */
+    bool clipWideLines = false;
+  };
+
   /**
    * @brief Create an object to convert the multiline string @p text
    *        into an array of text fields based on the column structure
    *        of the text.
    * @param[in] text   a string with zero or more lines terminated by
    *                   newline characters.
-   *                   This assumes that the only space characters
-   *                   in the string are space (e.g., ASCII 32) and
-   *                   newline (e.g., ASCII 10). There should be no
-   *                   horizontal tab, vertical tab, carriage returns,
-   *                   form feeds, or non-ASCII characters.
+   *                   Horizontal tabs are expanded to the tab stops
+   *                   in Options, and each UTF-8 character counts
+   *                   as one column. There should be no vertical
+   *                   tab, carriage returns, or form feeds.
    */
   explicit TableText(const std::string &text);
 
@@ -64,19 +129,73 @@ public:
    *        of the text.
    * @param[in] text   a string with zero or more lines terminated by
    *                   newline characters.
-   *                   This assumes that the only space characters
-   *                   in the string are space (e.g., ASCII 32) and
-   *                   newline (e.g., ASCII 10). There should be no
-   *                   horizontal tab, vertical tab, carriage returns,
-   *                   form feeds, or non-ASCII characters.
+   *                   Horizontal tabs are expanded to the tab stops
+   *                   in Options, and each UTF-8 character counts
+   *                   as one column. There should be no vertical
+   *                   tab, carriage returns, or form feeds.
    */
   explicit TableText(const char *multilineText);
 
+  /**
+   * @brief Create an object using the settings in @p options
+   * @exception LimitError  the text exceeds a limit in @p options
+   */
+  TableText(const std::string &text, const Options &options);
+
+  /**
+   * @brief Create an object using the settings in @p options
+   * @exception LimitError  the text exceeds a limit in @p options
+   */
+  TableText(const char *multilineText, const Options &options);
+
   /**
    * @brief Type used to hold the array of array of column fields.
    */
   using RowAndColumnList = std::vector<std::vector<std::string>>;
 
+  /// A type used to hold the beginning and ending of a column
+  struct ColumnRange {
+    std::size_t begin;          // the first column
+    std::size_t end;            // one past the last column
+
+    bool operator==(const ColumnRange &other) const noexcept
+    {
+      return (begin == other.begin) && (end == other.end);
+    }
+  };
+
+  /// The positions of all the columns of a table from left to right
+  using ColumnLayout = std::vector<ColumnRange>;
+
+  /**
+   * @brief A field that refers to characters stored elsewhere (e.g.,
+   *        in a memory mapped file). It is only valid as long as the
+   *        storage it refers to.
+   */
+  struct FieldSpan {
+    const char *data;
+    std::size_t length;
+
+    std::string str() const
+    {
+      return std::string(data, length);
+    }
+  };
+
+  /// The fields of one row as spans into the table text
+  using SpanRow = std::vector<FieldSpan>;
+
+  /**
+   * @brief Find the column positions that tabulate() would use.
+   * @param minCols  indicates that a minimum number of columns
+   *                 is expected in the text lines.
+   * @exception std::out_of_range  this exception indicates
+   * that the algorithm could not identify @p minCols or more
+   * columns.
+   */
+  ColumnLayout
+  findLayout(unsigned minCols=0u) const;
+
   /**
    * @brief Convert the lines of text into a collection of separated
    *        fields based on the whitespace of the table.
@@ -91,6 +210,277 @@ public:
   RowAndColumnList
   tabulate(unsigned minCols=0u) const;
 
+  /**
+   * @brief Convert the lines of text into a collection of separated
+   *        fields using a column layout that is already known (e.g.,
+   *        from findLayout() or a cache).
+   */
+  RowAndColumnList
+  tabulate(const ColumnLayout &layout) const;
+
+  /**
+   * @brief Like tabulate(minCols) but the fields are stored in @p result,
+   *        reusing the memory of the rows and strings it already holds.
+   *        Reusing one result object for many tables avoids most
+   *        memory allocation.
+   * @exception std::out_of_range  as in tabulate(minCols)
+   */
+  void
+  tabulate(unsigned minCols, RowAndColumnList &result) const;
+
+  /**
+   * @brief Like tabulate(layout) but the fields are stored in @p result,
+   *        reusing the memory of the rows and strings it already holds.
+   */
+  void
+  tabulate(const ColumnLayout &layout, RowAndColumnList &result) const;
+
+  /**
+   * @brief Replace the text with @p text and count the spaces again.
+   *
+   * This gives the same result as constructing a new object, but the
+   * memory already allocated for the text and the counts is reused.
+   * A worker that processes many logs can keep one object.
+   * @exception LimitError  the text exceeds a limit in Options. The
+   *            object is left holding no text.
+   */
+  void
+  reset(const std::string &text);
+
+  /// Replace the text with @p multilineText and count the spaces again
+  void
+  reset(const char *multilineText);
+
+  /**
+   * @brief A change to one line of the text
+   */
+  struct LineEdit {
+    enum class Kind {
+      Insert,                   ///< insert @c text before row @c row
+      Remove,                   ///< remove row @c row
+      Replace                   ///< replace row @c row with @c text
+    };
+    Kind kind;
+    /// the row index in the text as it is when the edit is applied
+    std::size_t row;
+    /// the new line without a newline character
+    std::string text;
+  };
+
+  using EditList = std::vector<LineEdit>;
+
+  /**
+   * @brief Change lines of the text, for example, when a corrected log
+   *        is resubmitted. The space counts are adjusted in time
+   *        proportional to the number of changed rows times the width
+   *        instead of counting the whole text again, and the text is
+   *        rebuilt in one pass for the whole list.
+   *
+   * Every edit is checked before anything changes, so if an exception
+   * is thrown the text is left as it was.
+   * @param edits  the edits are applied in order, so each row index
+   *               refers to the text after the previous edits.
+   * @exception std::out_of_range  an edit refers to a row that doesn't
+   *            exist
+   * @exception std::invalid_argument  the text of an edit contains a
+   *            newline
+   * @exception LimitError  an edit would exceed a limit in Options
+   */
+  void
+  applyEdits(const EditList &edits);
+
+  /**
+   * @brief Apply @p edits and update a previous tabulation to match.
+   *
+   * If the space counts still produce the same column layout, only the
+   * rows named in @p edits are tabulated. Otherwise, @p layout is
+   * replaced by the new layout, and all the rows are tabulated again.
+   * @param minCols        as in tabulate()
+   * @param[in,out] layout the layout that was used to produce @p rows
+   * @param[in,out] rows   the rows tabulated before the edits
+   * @return true if the previous layout was reused
+   * @exception std::out_of_range  see applyEdits() and tabulate()
+   */
+  bool
+  retabulate(const EditList     &edits,
+             unsigned            minCols,
+             ColumnLayout       &layout,
+             RowAndColumnList   &rows);
+
+  /// A run of consecutive rows that share a column layout
+  struct Segment {
+    std::size_t firstRow;
+    std::size_t numRows;
+    ColumnLayout layout;
+  };
+
+  using SegmentList = std::vector<Segment>;
+
+  /**
+   * @brief Find the rows where the column layout changes (e.g., in a log
+   *        merged from several operating positions) and the layout of
+   *        each segment.
+   *
+   * The space counts of windows of @p window rows are compared. The
+   * layout changes where a column that is blank in every row of one
+   * window holds characters in nearly every row of the next. The split
+   * row is then located within the two windows, and neighboring
+   * segments that don't conflict this way as a whole are joined again.
+   * @param minCols  the minimum number of columns in every segment
+   * @param window   the number of rows compared at a time
+   * @exception std::out_of_range  a segment has fewer than @p minCols
+   *            columns
+   */
+  SegmentList
+  findSegments(unsigned minCols=0u, std::size_t window=32u) const;
+
+  /// The rows of a table tabulated one segment at a time
+  struct SegmentedRows {
+    SegmentList segments;
+    RowAndColumnList rows;
+    /// rowSegments[i] is the index in segments of the segment holding row i
+    std::vector<std::size_t> rowSegments;
+  };
+
+  /**
+   * @brief Tabulate each segment found by findSegments() with its own
+   *        layout. The segments are independent, so they are tabulated
+   *        on up to @p threads threads.
+   * @exception std::out_of_range  as in findSegments()
+   */
+  SegmentedRows
+  tabulateSegments(unsigned minCols=0u, unsigned threads=1u) const;
+
+  /// A column layout and measures of how well it fits the rows
+  struct LayoutCandidate {
+    ColumnLayout layout;
+    /// the fewest spaces that ended a column when the layout was found
+    int minSpaceForColEnd;
+    /// cells with an edge that cuts through a word, per cell
+    double straddles;
+    /// empty cells, per cell
+    double empties;
+    /**
+     * @brief cells holding a gap that is blank in 3/4 of the rows,
+     *        so they probably hold two columns, per cell
+     */
+    double merges;
+    /// the sum of the measures. Lower is better.
+    double score;
+  };
+
+  using CandidateList = std::vector<LayoutCandidate>;
+
+  /**
+   * @brief Return every distinct layout findLayout() considers, best
+   *        first, so a caller that doesn't know how many columns to
+   *        expect can choose one without tabulating the text for each.
+   *
+   * Every candidate is scored in one pass over the rows. Candidates
+   * with the same score keep the order findLayout() tries them in.
+   * @param minCols  leave out layouts with fewer columns
+   * @exception std::out_of_range  no layout has @p minCols columns
+   */
+  CandidateList rankLayouts(unsigned minCols=0u) const;
+
+  /**
+   * @brief return the layout rankLayouts() puts first
+   * @exception std::out_of_range  as in rankLayouts()
+   */
+  ColumnLayout findBestLayout(unsigned minCols=0u) const;
+
+  /**
+   * @brief Call @p func once per line of text, in order, with the
+   *        fields of the line as a SpanRow. The spans point into this
+   *        object's text, and the SpanRow is reused for the next line,
+   *        so no strings are created.
+   * @param layout  the column layout (e.g., from findLayout())
+   * @param func    a callable taking <tt>const SpanRow &</tt>
+   */
+  template <typename RowFunc>
+  void
+  forEachRow(const ColumnLayout &layout, RowFunc &&func) const
+  {
+    SpanRow row;
+    row.reserve(layout.size());
+    const char *cur(d_text.data());
+    const char *const end(cur + d_text.size());
+    while (cur < end) {
+      const char *const next(static_cast<const char *>
+                             (std::memchr(cur, '\n', end - cur)));
+      const char *const lineEnd(next ? next : end);
+      spansFromLine(layout, cur, lineEnd - cur, row);
+      func(static_cast<const SpanRow &>(row));
+      cur = (next ? (next + 1) : end);
+    }
+  }
+
+  /**
+   * @brief return the text being tabulated
+   */
+  const std::string &getText() const noexcept
+  {
+    return d_text;
+  }
+
+  /**
+   * @brief return true if the text is plain ASCII with no tabs. Then,
+   *        column positions and character positions are the same.
+   */
+  bool isPlainText() const noexcept
+  {
+    return d_plain;
+  }
+
+  /// The classes of characters counted when Options::profileColumns is set
+  enum CharClass {
+    e_Digit,                    ///< 0-9
+    e_Letter,                   ///< A-Z, a-z, and non-ASCII characters
+    e_Dash,                     ///< -
+    e_Slash,                    ///< /
+    e_NumCharClasses
+  };
+
+  /// What the values in a column appear to be
+  enum class ColumnType {
+    Empty,                      ///< nothing but spaces
+    Numeric,                    ///< only digits (e.g., frequency or serial number)
+    Date,                       ///< digits and dashes (e.g., 2014-10-04)
+    Time,                       ///< four digits following a Date column
+    Callsign,                   ///< letters and digits, perhaps with slashes
+    Text,                       ///< letters, perhaps with spaces, dashes or slashes
+    Mixed                       ///< anything else
+  };
+
+  /// The number of characters of each kind in a range of columns in all rows
+  struct ColumnProfile {
+    std::size_t spaces;         ///< including the padding of short lines
+    std::size_t digits;
+    std::size_t letters;
+    std::size_t dashes;
+    std::size_t slashes;
+    std::size_t others;
+  };
+
+  /**
+   * @brief return the number of characters of class @p cls in each column
+   * @exception std::logic_error  Options::profileColumns was not set
+   */
+  const std::vector<int> &getCharCounts(CharClass cls) const;
+
+  /**
+   * @brief add up the characters of each kind in a range of columns
+   * @exception std::logic_error  Options::profileColumns was not set
+   */
+  ColumnProfile getProfile(const ColumnRange &range) const;
+
+  /**
+   * @brief guess what kind of value each column in @p layout holds,
+   *        so a typed parser can go straight to the right decoder
+   * @exception std::logic_error  Options::profileColumns was not set
+   */
+  std::vector<ColumnType> inferColumnTypes(const ColumnLayout &layout) const;
+
   /**
    * @brief return the number of lines in the text.
    */
@@ -101,11 +491,18 @@ public:
 
   /**
    * @brief return the number of columns in the widest line of text
+   *        that isn't an outlier (see Options::clipWideLines)
    */
   std::size_t getMaxWidth() const noexcept
   {
     return d_spaceCounts.size();
   }
+
+  /**
+   * @brief return the rows wider than Options::maxWidth that were
+   *        treated as outliers because Options::clipWideLines is set
+   */
+  std::vector<std::size_t> getOutlierRows() const;
 private:
   /// One cannot construct this object without the text.
   TableText() = delete;
@@ -117,61 +514,188 @@ private:
    * is based on counting the number of spaces per column in the text.
    * This routine efficiently counts the number of spaces per column
    * in the text treating short lines as though they were padded with
-   * spaces at the end.
+   * spaces at the end. The padding is added once at the end from a
+   * histogram of the line widths, so the time is proportional to the
+   * size of the text rather than the rows times the widest line.
    */
   void
   countSpaces();
 
+  /// @exception LimitError  @p numBytes is more than Options::maxBytes
+  void
+  checkBytes(std::size_t numBytes) const;
+
+  /**
+   * @brief return the number of columns of a line that are counted,
+   *        which is zero for an outlier
+   * @exception LimitError  the line is wider than Options::maxWidth and
+   *            Options::clipWideLines is not set
+   */
+  std::size_t
+  countedWidth(const char *line, std::size_t len) const;
+
+  /// return true if a line @p width columns wide is an outlier
+  bool
+  isOutlier(std::size_t width) const noexcept;
+
+  /**
+   * @brief add the spaces of a line to the space counts. The line is
+   *        not added to the row count.
+   */
+  void
+  addLineSpaces(const char *line, std::size_t len);
+
+  /**
+   * @brief remove the spaces of a line that was previously added to
+   *        the space counts. The line is not removed from the row count.
+   */
+  void
+  removeLineSpaces(const char *line, std::size_t len);
+
+  /// return the number of characters in row @p row excluding the newline
+  std::size_t
+  lineLength(std::size_t row) const noexcept;
+
+  /**
+   * @brief return the number of columns a line occupies when tabs are
+   *        expanded and UTF-8 sequences count as one column
+   */
+  std::size_t
+  displayWidth(const char *line, std::size_t len) const noexcept;
+
+  /**
+   * @brief add or remove (@p delta of -1) the spaces and characters of
+   *        a line without the padding after its end
+   */
+  void
+  countLineSpaces(const char *line, std::size_t len, int delta);
+
+  /// add or remove (@p delta of -1) the padding of a line @p width columns wide
+  void
+  padLine(std::size_t width, int delta);
+
+  /// add or remove (@p delta of -1) the spaces of a line with tabs or UTF-8
+  void
+  countDisplaySpaces(const char *line, std::size_t len, int delta);
+
+  /// add or remove (@p delta of -1) the spaces of a plain ASCII line
+  void
+  countPlainSpaces(const char *line, std::size_t len, int delta);
+
+  /**
+   * @brief change the width of all the counts. New columns start with
+   *        @p padding spaces (the rows so far that are already padded).
+   */
+  void
+  resizeCounts(std::size_t width, int padding);
+
   /// Return a sorted list of all the unique space counts in the
   /// vector of space counts per column. The returned vector is sorted
   /// from smallest to largest element, and it always includes zero.
-  std::vector<int>
-  uniqueSpaceCounts() const;
+  static std::vector<int>
+  uniqueSpaceCounts(const std::vector<int> &spaceCounts);
 
   /**
-   * @brief The table text where each element of the std::vector is a line of text
-   *
-   * Each entry does not have a newline character at the end.
+   * @brief find the layout of @p numRows rows with the space counts
+   *        @p spaceCounts (see findLayout())
+   */
+  static ColumnLayout
+  layoutFromCounts(const std::vector<int> &spaceCounts,
+                   std::size_t             numRows,
+                   unsigned                minCols);
+
+  /// The space counts of a range of rows used to find segments
+  struct SpaceHistogram;
+
+  /// count the spaces of rows @p first to @p last (exclusive) into @p hist
+  void
+  countRows(std::size_t first, std::size_t last, SpaceHistogram &hist) const;
+
+  /// return true if column @p col of row @p row is blank
+  bool
+  isBlankAt(std::size_t row, std::size_t col) const;
+
+  /// return true if row @p row is blank in every column of @p gaps
+  bool
+  fitsGaps(std::size_t row, const std::vector<std::size_t> &gaps) const;
+
+  /**
+   * @brief set @p filled[col] to 1 for each column of row @p row
+   *        holding a character other than a space, and 0 elsewhere.
+   *        @p filled must be as wide as the space counts.
    */
-  const std::string d_text;
+  void
+  markFilled(std::size_t row, std::vector<unsigned char> &filled) const;
+
+  /**
+   * @brief The table text with lines separated by newline characters
+   */
+  std::string d_text;
+
+  /// d_lineStarts[i] is the position in d_text where row i starts
+  std::vector<std::size_t> d_lineStarts;
 
   /**
    * @brief d_spaceCounts[i] holds the number of spaces in column i of all the text lines
    */
   std::vector<int> d_spaceCounts;
 
+  /**
+   * @brief d_charCounts[c][i] holds the number of characters of
+   *        CharClass c in column i of all the text lines. Each class
+   *        has its own array so the counting loop can be vectorized.
+   *        These are empty unless Options::profileColumns is set.
+   */
+  std::vector<int> d_charCounts[e_NumCharClasses];
+
+  /**
+   * @brief d_widthCounts[w] holds the number of lines w columns wide,
+   *        with outliers counted as zero wide. An unterminated last
+   *        line isn't padded, so it isn't counted either. Edits keep it
+   *        up to date, so the widest line is known without measuring
+   *        them all.
+   */
+  std::vector<int> d_widthCounts;
+
   /// The number of lines in the table
   std::size_t d_numRows;
 
-  /// An internal type used to hold the beginning and ending of a column
-  struct ColumnRange {
-    std::size_t begin;          // the first column
-    std::size_t end;            // one past the last column
-  };
+  Options d_options;
+
+  /// true if the text is ASCII without tabs
+  bool d_plain;
 
   /**
    * @brief find all the columns in the text assuming that a brief
    *        between columns must have at least @p minSpaceForColEnd
    *        spaces
+   * @param spaceCounts       the number of spaces in each column
+   * @param numLines          the number of lines counted
    * @parm minSpaceForColEnd  the minimum number of spaces that
    *                          indicaters a break between columns
    * @param[out] table        a vector to hold the column definitions
    *                          on output
    */
-  void
-  findColumns(const int                 minSpaceForColEnd,
-              std::vector<ColumnRange> &table) const;
+  static void
+  findColumns(const std::vector<int>   &spaceCounts,
+              const int                 numLines,
+              const int                 minSpaceForColEnd,
+              std::vector<ColumnRange> &table);
 
   /**
    * @brief convert a single line of text into a list of
-   *        column string values
+   *        trimmed column values that refer to the line
    * @param table  indicates the starting and ending position
    *               each each table column.
-   * @param line   the line of text
+   * @param line   the first character of the line of text
+   * @param len    the number of characters in the line excluding
+   *               the newline
+   * @param[out] row  the fields of the line
    */
-  RowAndColumnList::value_type
-  fieldsFromLine(const std::vector<ColumnRange> &table,
-                 const std::string &line) const;
+  void
+  spansFromLine(const std::vector<ColumnRange> &table,
+                const char *line, std::size_t len,
+                SpanRow &row) const;
 
   /**
    * @brief convert all the lines of text into a collection
@@ -181,6 +705,18 @@ private:
   RowAndColumnList
   copyColumns(const std::vector<ColumnRange> &table) const;
 
+  /**
+   * @brief the same as copyColumns but storing the fields in @p result
+   *        reusing its memory
+   */
+  void
+  copyColumns(const std::vector<ColumnRange> &table,
+              RowAndColumnList &result) const;
+
+  /// forget the counts of the previous text
+  void
+  clearCounts() noexcept;
+
 };
 
 }
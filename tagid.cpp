@@ -0,0 +1,223 @@
+#include "tagid.h"
+
+#include <cstdint>
+
+using namespace cab;
+
+namespace {
+struct KnownTag {
+  const char *name;
+  TagId id;
+};
+
+/// in the order of TagId starting from StartOfLog
+constexpr KnownTag s_knownTags[] = {
+  { "START-OF-LOG", TagId::StartOfLog },
+  { "END-OF-LOG", TagId::EndOfLog },
+  { "CALLSIGN", TagId::Callsign },
+  { "CONTEST", TagId::Contest },
+  { "CATEGORY", TagId::Category },
+  { "CATEGORY-ASSISTED", TagId::CategoryAssisted },
+  { "CATEGORY-BAND", TagId::CategoryBand },
+  { "CATEGORY-MODE", TagId::CategoryMode },
+  { "CATEGORY-OPERATOR", TagId::CategoryOperator },
+  { "CATEGORY-POWER", TagId::CategoryPower },
+  { "CATEGORY-STATION", TagId::CategoryStation },
+  { "CATEGORY-TIME", TagId::CategoryTime },
+  { "CATEGORY-TRANSMITTER", TagId::CategoryTransmitter },
+  { "CATEGORY-OVERLAY", TagId::CategoryOverlay },
+  { "CERTIFICATE", TagId::Certificate },
+  { "CLAIMED-SCORE", TagId::ClaimedScore },
+  { "CLUB", TagId::Club },
+  { "CREATED-BY", TagId::CreatedBy },
+  { "EMAIL", TagId::Email },
+  { "GRID-LOCATOR", TagId::GridLocator },
+  { "LOCATION", TagId::Location },
+  { "ARRL-SECTION", TagId::ArrlSection },
+  { "IOTA-ISLAND-NAME", TagId::IotaIslandName },
+  { "NAME", TagId::Name },
+  { "ADDRESS", TagId::Address },
+  { "ADDRESS-CITY", TagId::AddressCity },
+  { "ADDRESS-STATE-PROVINCE", TagId::AddressStateProvince },
+  { "ADDRESS-POSTALCODE", TagId::AddressPostalcode },
+  { "ADDRESS-COUNTRY", TagId::AddressCountry },
+  { "OPERATORS", TagId::Operators },
+  { "OFFTIME", TagId::Offtime },
+  { "SOAPBOX", TagId::Soapbox },
+  { "DEBUG", TagId::Debug },
+  { "QSO", TagId::Qso },
+  { "X-QSO", TagId::XQso }
+};
+
+constexpr std::size_t s_numKnownTags(sizeof(s_knownTags) / sizeof(s_knownTags[0]));
+
+constexpr bool
+inIdOrder() noexcept
+{
+  for (std::size_t i = 0u; i < s_numKnownTags; ++i) {
+    if (static_cast<std::size_t>(s_knownTags[i].id) !=
+        (static_cast<std::size_t>(TagId::StartOfLog) + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(inIdOrder(), "s_knownTags must be in the order of TagId");
+
+/// the number of slots in the hash table (a power of two)
+constexpr unsigned s_tableBits(8u);
+constexpr std::size_t s_tableSize(std::size_t(1u) << s_tableBits);
+
+/// fold lowercase letters to uppercase; dashes map to a value no letter has
+constexpr std::uint32_t
+fold(char ch) noexcept
+{
+  return static_cast<unsigned char>(ch) & 0xdfu;
+}
+
+/// one step of FNV-1a
+constexpr std::uint32_t
+hashStep(std::uint32_t hash, std::uint32_t folded) noexcept
+{
+  return (hash ^ folded) * 16777619u;
+}
+
+constexpr std::size_t
+slotOf(std::uint32_t hash) noexcept
+{
+  return static_cast<std::size_t>((hash * 2654435761u) >> (32u - s_tableBits));
+}
+
+constexpr std::uint32_t
+nameHash(const char *name, std::uint32_t seed) noexcept
+{
+  std::uint32_t hash(seed);
+  for (; *name; ++name) {
+    hash = hashStep(hash, fold(*name));
+  }
+  return hash;
+}
+
+struct HashTable {
+  std::uint32_t seed;
+  /// one more than the index in s_knownTags, or zero for an empty slot
+  unsigned char slots[s_tableSize];
+};
+
+/// fill @p table using @p seed. Returns false if two tags collide.
+constexpr bool
+fillTable(std::uint32_t seed, HashTable &table) noexcept
+{
+  table.seed = seed;
+  for (std::size_t i = 0u; i < s_tableSize; ++i) {
+    table.slots[i] = 0u;
+  }
+  for (std::size_t i = 0u; i < s_numKnownTags; ++i) {
+    const std::size_t slot(slotOf(nameHash(s_knownTags[i].name, seed)));
+    if (table.slots[slot]) {
+      return false;
+    }
+    table.slots[slot] = static_cast<unsigned char>(i + 1u);
+  }
+  return true;
+}
+
+/// try seeds until one gives a table without collisions
+constexpr HashTable
+buildTable() noexcept
+{
+  HashTable table{ 0u, {} };
+  for (std::uint32_t seed = 2166136261u; seed != (2166136261u + 100000u); ++seed) {
+    if (fillTable(seed, table)) {
+      return table;
+    }
+  }
+  table.seed = 0u;
+  return table;
+}
+
+constexpr HashTable s_table(buildTable());
+static_assert(0u != s_table.seed, "No perfect hash was found for the Cabrillo tags");
+
+/**
+ * @brief scan the characters of a tag name starting at @p begin
+ * @return the end of the name, which is @p begin if it isn't a valid
+ *         name
+ */
+inline const char *
+scanName(const char *begin, const char *end, std::uint32_t &hash) noexcept
+{
+  bool wantLetter(true);
+  const char *cur(begin);
+  for (; cur < end; ++cur) {
+    const unsigned ch(static_cast<unsigned char>(*cur));
+    if (((ch | 0x20u) - 'a') < 26u) {
+      wantLetter = false;
+    }
+    else if (('-' == ch) && !wantLetter) {
+      wantLetter = true;
+    }
+    else {
+      break;
+    }
+    hash = hashStep(hash, fold(*cur));
+  }
+  // names can't end with a dash
+  return wantLetter ? begin : cur;
+}
+
+TagId
+classify(const char *name, std::size_t len, std::uint32_t hash) noexcept
+{
+  const unsigned entry(s_table.slots[slotOf(hash)]);
+  if (entry) {
+    const char *known(s_knownTags[entry - 1u].name);
+    std::size_t i(0u);
+    while ((i < len) && known[i] && (fold(known[i]) == fold(name[i]))) {
+      ++i;
+    }
+    if ((i == len) && !known[i]) {
+      return s_knownTags[entry - 1u].id;
+    }
+  }
+  if ((len > 2u) && ('X' == fold(name[0])) && ('-' == name[1])) {
+    return TagId::Extension;
+  }
+  return TagId::Unknown;
+}
+}
+
+TagId
+cab::recognizeTag(const char *begin, const char *end, std::size_t *length) noexcept
+{
+  std::uint32_t hash(s_table.seed);
+  const char *const nameEnd(scanName(begin, end, hash));
+  if ((nameEnd == begin) || (nameEnd == end) || (':' != *nameEnd)) {
+    return TagId::None;
+  }
+  const std::size_t len(static_cast<std::size_t>(nameEnd - begin));
+  if (length) {
+    *length = len;
+  }
+  return classify(begin, len, hash);
+}
+
+TagId
+cab::tagIdFromName(const std::string &name) noexcept
+{
+  std::uint32_t hash(s_table.seed);
+  const char *const begin(name.data());
+  const char *const end(begin + name.size());
+  if (name.empty() || (scanName(begin, end, hash) != end)) {
+    return TagId::None;
+  }
+  return classify(begin, name.size(), hash);
+}
+
+const char *
+cab::tagName(TagId id) noexcept
+{
+  const std::size_t index(static_cast<std::size_t>(id) -
+                          static_cast<std::size_t>(TagId::StartOfLog));
+  return (index < s_numKnownTags) ? s_knownTags[index].name : "";
+}
@@ -0,0 +1,85 @@
+/**
+ * @file   tagid.h
+ * @brief  Recognize Cabrillo tags without regular expressions
+ *
+ * The tags of the Cabrillo v3 specification (plus a few left over from
+ * v2) are placed in a perfect hash table that is built by the compiler.
+ * Classifying the start of a line costs one pass over the tag
+ * characters, one table lookup and one comparison.
+ */
+#ifndef __TAGID_H_LOADED__
+#define __TAGID_H_LOADED__
+#include <cstddef>
+#include <string>
+
+namespace cab {
+
+/// The tags of a Cabrillo log
+enum class TagId : unsigned char {
+  None,                         ///< not a tag (e.g., a wrapped line)
+  Unknown,                      ///< shaped like a tag, but not a known one
+  Extension,                    ///< X- followed by anything but QSO
+  StartOfLog,
+  EndOfLog,
+  Callsign,
+  Contest,
+  Category,                     ///< Cabrillo v2
+  CategoryAssisted,
+  CategoryBand,
+  CategoryMode,
+  CategoryOperator,
+  CategoryPower,
+  CategoryStation,
+  CategoryTime,
+  CategoryTransmitter,
+  CategoryOverlay,
+  Certificate,
+  ClaimedScore,
+  Club,
+  CreatedBy,
+  Email,
+  GridLocator,
+  Location,
+  ArrlSection,                  ///< Cabrillo v2
+  IotaIslandName,               ///< Cabrillo v2
+  Name,
+  Address,
+  AddressCity,
+  AddressStateProvince,
+  AddressPostalcode,
+  AddressCountry,
+  Operators,
+  Offtime,
+  Soapbox,
+  Debug,
+  Qso,
+  XQso
+};
+
+/**
+ * @brief classify the tag at the start of the characters from @p begin
+ *        to @p end. A tag is letters, perhaps in groups separated by
+ *        single dashes, followed by a colon, in any case.
+ * @param[out] length  if not null, the number of characters in the tag
+ *                     not counting the colon
+ * @return TagId::None if the characters don't start with a tag
+ */
+TagId
+recognizeTag(const char *begin, const char *end, std::size_t *length = nullptr) noexcept;
+
+/**
+ * @brief classify the tag name @p name (without a colon) in any case
+ */
+TagId
+tagIdFromName(const std::string &name) noexcept;
+
+/**
+ * @brief return the name of @p id as written in the specification
+ *        (e.g., START-OF-LOG), or an empty string for None, Unknown
+ *        and Extension
+ */
+const char *
+tagName(TagId id) noexcept;
+}
+
+#endif /* __TAGID_H_LOADED__ */
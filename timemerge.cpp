@@ -0,0 +1,138 @@
+#include "timemerge.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+using namespace cab;
+
+namespace {
+/// read @p count digits from @p text at @p pos, or return false
+bool
+readDigits(const std::string &text, std::size_t pos, std::size_t count,
+           std::uint64_t &value) noexcept
+{
+  if ((pos + count) > text.size()) {
+    return false;
+  }
+  value = 0u;
+  for (std::size_t i = pos; i < (pos + count); ++i) {
+    if ((text[i] < '0') || (text[i] > '9')) {
+      return false;
+    }
+    value = 10u*value + static_cast<std::uint64_t>(text[i] - '0');
+  }
+  return true;
+}
+
+/// the heap of heads is a min heap on time, log and row
+bool
+later(const TimeMerge::Row &a, const TimeMerge::Row &b) noexcept
+{
+  return (a.time > b.time) ||
+         ((a.time == b.time) && ((a.log > b.log) || ((a.log == b.log) && (a.row > b.row))));
+}
+}
+
+std::uint64_t
+cab::qsoTimeKey(const std::string &date, const std::string &time) noexcept
+{
+  std::uint64_t year, month, day, hour, minute, second(0u);
+  if ((date.size() != 10u) || ('-' != date[4]) || ('-' != date[7]) ||
+      !readDigits(date, 0u, 4u, year) || !readDigits(date, 5u, 2u, month) ||
+      !readDigits(date, 8u, 2u, day) ||
+      ((time.size() != 4u) && (time.size() != 6u)) ||
+      !readDigits(time, 0u, 2u, hour) || !readDigits(time, 2u, 2u, minute) ||
+      ((time.size() == 6u) && !readDigits(time, 4u, 2u, second))) {
+    return 0u;
+  }
+  if ((month < 1u) || (month > 12u) || (day < 1u) || (day > 31u) ||
+      (hour > 23u) || (minute > 59u) || (second > 59u)) {
+    return 0u;
+  }
+  return (year << 40) | (month << 32) | (day << 24) | (hour << 16) |
+         (minute << 8) | second;
+}
+
+TimeMerge::TimeMerge(const std::vector<const TableText::RowAndColumnList *> &logs)
+  : TimeMerge(logs, Options())
+{
+}
+
+TimeMerge::TimeMerge(const std::vector<const TableText::RowAndColumnList *> &logs,
+                     const Options &options)
+  : d_logs(logs),
+    d_options(options),
+    d_inputs(logs.size()),
+    d_numReordered(0u),
+    d_numOutOfWindow(0u)
+{
+  if (0u == options.window) {
+    throw std::invalid_argument("The reorder window must hold at least one row");
+  }
+  d_heads.reserve(logs.size());
+  for (std::size_t log = 0u; log < logs.size(); ++log) {
+    d_inputs[log].window.reserve(options.window);
+    fill(log);
+    advance(log);
+  }
+}
+
+void
+TimeMerge::fill(std::size_t log)
+{
+  Input &input(d_inputs[log]);
+  const TableText::RowAndColumnList &rows(*d_logs[log]);
+  while ((input.window.size() < d_options.window) && (input.nextRow < rows.size())) {
+    const std::vector<std::string> &cells(rows[input.nextRow]);
+    std::uint64_t time(0u);
+    if (std::max(d_options.dateColumn, d_options.timeColumn) < cells.size()) {
+      time = qsoTimeKey(cells[d_options.dateColumn], cells[d_options.timeColumn]);
+    }
+    if (0u == time) {
+      time = input.lastRead;
+    }
+    input.lastRead = time;
+    input.window.emplace_back(time, input.nextRow++);
+    std::push_heap(input.window.begin(), input.window.end(), std::greater<Pending>());
+  }
+}
+
+void
+TimeMerge::advance(std::size_t log)
+{
+  Input &input(d_inputs[log]);
+  if (input.window.empty()) {
+    return;
+  }
+  std::pop_heap(input.window.begin(), input.window.end(), std::greater<Pending>());
+  const Pending pending(input.window.back());
+  input.window.pop_back();
+  fill(log);
+
+  if (input.started && (pending.second < input.maxRow)) {
+    ++d_numReordered;
+  }
+  if (input.started && (pending.first < input.lastTime)) {
+    // the row was too far back for the window to catch it
+    ++d_numOutOfWindow;
+  }
+  input.maxRow = std::max(input.maxRow, pending.second);
+  input.lastTime = std::max(input.lastTime, pending.first);
+  input.started = true;
+  d_heads.push_back(Row{ log, pending.second, pending.first });
+  std::push_heap(d_heads.begin(), d_heads.end(), later);
+}
+
+bool
+TimeMerge::next(Row &row)
+{
+  if (d_heads.empty()) {
+    return false;
+  }
+  std::pop_heap(d_heads.begin(), d_heads.end(), later);
+  row = d_heads.back();
+  d_heads.pop_back();
+  advance(row.log);
+  return true;
+}
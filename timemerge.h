@@ -0,0 +1,131 @@
+/**
+ * @file   timemerge.h
+ * @brief  Interleave the QSO lines of several logs in time order
+ *
+ * Multi-transmitter stations and club aggregates submit several logs
+ * whose QSO lines must be interleaved by date and time, for example
+ * to measure rates or check band change rules. Each log is already
+ * nearly in time order, so concatenating and sorting them all wastes
+ * most of its work.
+ *
+ * TimeMerge packs the date and time of each QSO line into a 64-bit
+ * key and streams the rows of all logs through a heap holding one
+ * candidate per log. In front of that heap, every log passes through
+ * a small reorder window of its own: a row that is a few lines from
+ * its place in time is moved back into order, while a row further
+ * away than the window is passed on where it is and counted.
+ */
+#ifndef __TIMEMERGE_H_LOADED__
+#define __TIMEMERGE_H_LOADED__
+#include "tabletext.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cab {
+
+/**
+ * @brief return a key that orders a Cabrillo QSO date and time, or
+ *        zero if they can't be read.
+ * @param date  YYYY-MM-DD
+ * @param time  HHMM, or HHMMSS for logs that give seconds
+ */
+std::uint64_t
+qsoTimeKey(const std::string &date, const std::string &time) noexcept;
+
+class TimeMerge {
+public:
+  struct Options {
+    std::size_t dateColumn = 3u;
+    std::size_t timeColumn = 4u;
+    /// the number of rows of each log held to put them back in order
+    std::size_t window = 32u;
+  };
+
+  /// one row of the merged output
+  struct Row {
+    std::size_t log;            ///< the index of the log in the list given
+    std::size_t row;            ///< the row in that log
+    std::uint64_t time;         ///< the key from qsoTimeKey
+  };
+
+  /**
+   * @brief merge @p logs, which must outlive this object. A row whose
+   *        date or time can't be read keeps its place after the row
+   *        before it.
+   */
+  explicit TimeMerge(const std::vector<const TableText::RowAndColumnList *> &logs);
+
+  /**
+   * @exception std::invalid_argument  the window is zero
+   */
+  TimeMerge(const std::vector<const TableText::RowAndColumnList *> &logs,
+            const Options &options);
+
+  /**
+   * @brief get the next row in time order. Rows with the same time are
+   *        taken in order of log and then row.
+   * @return false when every row has been returned
+   */
+  bool next(Row &row);
+
+  /// the cells of a row returned by next
+  const std::vector<std::string> &cells(const Row &row) const
+  {
+    return (*d_logs[row.log])[row.row];
+  }
+
+  /// the number of rows returned ahead of a row that came before them in their log
+  std::size_t getNumReordered() const noexcept
+  {
+    return d_numReordered;
+  }
+
+  /**
+   * @brief the number of rows that were too far from their place in
+   *        time to be moved back into order by the window, so they are
+   *        returned later than their time says
+   */
+  std::size_t getNumOutOfWindow() const noexcept
+  {
+    return d_numOutOfWindow;
+  }
+private:
+  TimeMerge() = delete;
+
+  /// a row waiting in a window, ordered by time and then row
+  using Pending = std::pair<std::uint64_t, std::size_t>;
+
+  /// the reorder window of one log
+  struct Input {
+    std::vector<Pending> window;
+    /// the next row to read into the window
+    std::size_t nextRow = 0u;
+    /// the time of the last row read, for rows without one
+    std::uint64_t lastRead = 0u;
+    /// the time of the last row returned
+    std::uint64_t lastTime = 0u;
+    /// the largest row returned so far
+    std::size_t maxRow = 0u;
+    bool started = false;
+  };
+
+  /// read rows of log @p log into its window until it's full
+  void fill(std::size_t log);
+
+  /// take the earliest row of log @p log from its window and offer it to the merge
+  void advance(std::size_t log);
+
+  std::vector<const TableText::RowAndColumnList *> d_logs;
+  Options d_options;
+  std::vector<Input> d_inputs;
+  /// the next row of each log with rows left
+  std::vector<Row> d_heads;
+  std::size_t d_numReordered;
+  std::size_t d_numOutOfWindow;
+};
+}
+
+#endif /*  __TIMEMERGE_H_LOADED__ */